@@ -9,17 +9,22 @@
  * and unvisited queue head moving forward through it, and unvisited queue end is the same
  * as end of visited queue, that means of whole list).
  * All are freed in whatever way the program ends.
+ * With -c the graph is kept in the compressed form of PART III instead.
+ * Besides phone pairs, stdin takes "phone k [minCalls]" lines, which list
+ * every phone within k calls of phone (see neighborhood()).
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 /* ------------------- PART I -- GRAPH --------------------- */
 
 typedef struct Node {      // nodes in graph
     char phone[13];        // xxx-xxx-xxxx + '\0'
+    int id;                // 0 .. nNodes-1, in the order nodes were added
     struct Node *next;     // another node in graph (not necessarily connected)
     struct Edge *adjList;  // edges connected to this node
 } Node;
@@ -35,6 +40,11 @@ typedef struct Edge {
 
 typedef struct {        // graph is wrapped around to be able to change firstNode in functions
     Node *firstNode;    // and not pass double pointer there
+    int nNodes;
+
+    // neighborhood() state, allocated by the first query and reused
+    unsigned char *reached;    // bit id is set if that node was reached
+    Node **found;              // reached nodes in BFS order
 } Graph;
 
 
@@ -44,8 +54,12 @@ typedef struct {        // graph is wrapped around to be able to change firstNod
 Graph *allocGraph()
 {
     Graph *graph = malloc(sizeof *graph);
-    if (graph != NULL)
+    if (graph != NULL) {
         graph->firstNode = NULL;
+        graph->nNodes = 0;
+        graph->reached = NULL;
+        graph->found = NULL;
+    }
     return graph;
 }
 
@@ -103,6 +117,7 @@ static int addNode(Graph *graph, char *phone)
     Node *node = allocNode(phone);
     if (node == NULL)
         return -1;
+    node->id = graph->nNodes++;
     node->next = graph->firstNode;
     graph->firstNode = node;
     return 0;
@@ -205,6 +220,8 @@ void removeGraph(Graph *graph)
         nextNode = node->next;
         free(node);
     }
+    free(graph->reached);
+    free(graph->found);
     free(graph);
 }
 
@@ -342,9 +359,516 @@ int BFS(Graph *graph, char *startPhone, char *targetPhone)
     return -1;
 }
 
+static int comparePhones(const void *a, const void *b)
+{
+    return strcmp((*(Node * const *)a)->phone, (*(Node * const *)b)->phone);
+}
+
+/*
+ * k-hop neighborhood: prints "phone distance" for every phone within hops
+ * calls of startPhone, following only edges with at least minCalls calls.
+ * It is one BFS cut off at level hops. Reached nodes are marked in a bitmap
+ * and appended to graph->found, so every level is a slice of it: once the
+ * next level is complete it is sorted and printed, and it becomes the
+ * frontier. At the end only the bits of the reached nodes are cleared.
+ * returns -1 if the phone does not exist, -2 if memory error,
+ * number of phones printed otherwise
+ */
+long neighborhood(Graph *graph, char *startPhone, int hops, int minCalls)
+{
+    Node *startNode = findNode(graph, startPhone);
+    if (startNode == NULL)
+        return -1;
+
+    // nodes are not added any more once queries are read
+    if (graph->reached == NULL) {
+        graph->reached = calloc(graph->nNodes / 8 + 1, 1);
+        graph->found = malloc(graph->nNodes * sizeof *graph->found);
+        if (graph->reached == NULL || graph->found == NULL) {
+            free(graph->reached);
+            free(graph->found);
+            graph->reached = NULL;
+            graph->found = NULL;
+            return -2;
+        }
+    }
+    unsigned char *reached = graph->reached;
+    Node **found = graph->found;
+
+    size_t levelStart = 0, levelEnd = 1, tail = 1;
+    found[0] = startNode;
+    reached[startNode->id / 8] |= 1 << startNode->id % 8;
+    for (int hop = 1; hop <= hops && levelStart < levelEnd; hop++) {
+        for (size_t i = levelStart; i < levelEnd; i++)
+            for (Edge *edge = found[i]->adjList; edge != NULL; edge = edge->next) {
+                int id = edge->to->id;
+                if (edge->nCalls < minCalls || (reached[id / 8] & 1 << id % 8))
+                    continue;
+                reached[id / 8] |= 1 << id % 8;
+                found[tail++] = edge->to;
+            }
+
+        // level hop is complete
+        qsort(found + levelEnd, tail - levelEnd, sizeof *found, comparePhones);
+        for (size_t i = levelEnd; i < tail; i++)
+            printf("%s %d\n", found[i]->phone, hop);
+        levelStart = levelEnd;
+        levelEnd = tail;
+    }
+
+    for (size_t i = 0; i < tail; i++)
+        reached[found[i]->id / 8] = 0;
+    return tail - 1;
+}
+
+
+
+/* ------------------- PART III -- COMPRESSED GRAPH ------------------- */
+
+/*
+ * optional compact form of the same graph (-c), for inputs whose linked
+ * Node/Edge form does not fit in memory.
+ * Phones get dense ids through an open addressing table keyed by their 10
+ * digits. Each call is collected once as a (lower id, higher id, nCalls)
+ * triple, and repeated pairs are merged by sorting whenever the buffer
+ * fills. Once all files are read, every node's neighbors are stored sorted
+ * in one byte array: the gap to the previous neighbor id, then nCalls - 1,
+ * both as varints (7 bits per byte, high bit set when another byte
+ * follows). A typical edge takes 2-4 bytes per direction instead of an
+ * Edge and its malloc header.
+ */
+
+typedef struct {
+    unsigned from, to;    // node ids, from < to
+    unsigned nCalls;
+} CallTriple;
+
+typedef struct {
+    // phone index
+    unsigned long long *keys;    // phone digits + 1, 0 is a free slot
+    unsigned *ids;
+    size_t capacity;
+    unsigned nNodes;
+    unsigned long long *phones;    // key of each id, built by buildCompressed()
+
+    // calls read so far, merged up to nMerged
+    CallTriple *calls;
+    size_t nCalls, callsCapacity, nMerged;
+
+    // adjacency, built by buildCompressed()
+    unsigned long long *offsets;    // node i's neighbors are adj[offsets[i] .. offsets[i+1])
+    unsigned char *adj;
+
+    // BFS state, reused by every query
+    unsigned *stamp;    // stamp[i] == curStamp if i was reached in this BFS
+    unsigned curStamp;
+    unsigned *queue;
+    int *level;
+    unsigned long long *levelKeys;    // cNeighborhood() output, allocated by its first query
+} CGraph;
+
+/*
+ * allocation of new compressed graph, returns it
+ */
+CGraph *allocCGraph()
+{
+    CGraph *graph = calloc(1, sizeof *graph);
+    if (graph == NULL)
+        return NULL;
+    graph->capacity = 1024;
+    graph->keys = calloc(graph->capacity, sizeof *graph->keys);
+    graph->ids = malloc(graph->capacity * sizeof *graph->ids);
+    if (graph->keys == NULL || graph->ids == NULL) {
+        free(graph->keys);
+        free(graph->ids);
+        free(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+/*
+ * phone xxx-xxx-xxxx as a number, + 1 so it is never 0
+ */
+static unsigned long long phoneKey(const char *phone)
+{
+    unsigned long long key = 0;
+    for (; *phone; phone++)
+        if (isdigit(*phone))
+            key = key * 10 + (*phone - '0');
+    return key + 1;
+}
+
+/*
+ * slot of key in the phone index, either holding it or free
+ */
+static size_t keySlot(unsigned long long *keys, size_t capacity, unsigned long long key)
+{
+    size_t slot = (key * 0x9e3779b97f4a7c15ull >> 20) & (capacity - 1);
+    while (keys[slot] != 0 && keys[slot] != key)
+        slot = (slot + 1) & (capacity - 1);
+    return slot;
+}
+
+/*
+ * find the id for the given phone,
+ * returns -1 if there is none
+ */
+static long findId(CGraph *graph, const char *phone)
+{
+    size_t slot = keySlot(graph->keys, graph->capacity, phoneKey(phone));
+    return graph->keys[slot] == 0 ? -1 : (long)graph->ids[slot];
+}
+
+/*
+ * id for the given phone, adding it if new
+ * returns -1 if memory error
+ */
+static long internPhone(CGraph *graph, const char *phone)
+{
+    unsigned long long key = phoneKey(phone);
+    size_t slot = keySlot(graph->keys, graph->capacity, key);
+    if (graph->keys[slot] != 0)
+        return graph->ids[slot];
+
+    // keep the table at most half full
+    if (2 * (graph->nNodes + 1) > graph->capacity) {
+        size_t capacity = graph->capacity * 2;
+        unsigned long long *keys = calloc(capacity, sizeof *keys);
+        unsigned *ids = malloc(capacity * sizeof *ids);
+        if (keys == NULL || ids == NULL) {
+            free(keys);
+            free(ids);
+            return -1;
+        }
+        for (size_t i = 0; i < graph->capacity; i++)
+            if (graph->keys[i] != 0) {
+                size_t to = keySlot(keys, capacity, graph->keys[i]);
+                keys[to] = graph->keys[i];
+                ids[to] = graph->ids[i];
+            }
+        free(graph->keys);
+        free(graph->ids);
+        graph->keys = keys;
+        graph->ids = ids;
+        graph->capacity = capacity;
+        slot = keySlot(keys, capacity, key);
+    }
+    graph->keys[slot] = key;
+    graph->ids[slot] = graph->nNodes;
+    return graph->nNodes++;
+}
+
+static int compareTriples(const void *a, const void *b)
+{
+    const CallTriple *x = a, *y = b;
+    if (x->from != y->from)
+        return x->from < y->from ? -1 : 1;
+    if (x->to != y->to)
+        return x->to < y->to ? -1 : 1;
+    return 0;
+}
+
+/*
+ * sort calls and add up repeated (from, to) pairs
+ */
+static void mergeCalls(CGraph *graph)
+{
+    qsort(graph->calls, graph->nCalls, sizeof *graph->calls, compareTriples);
+    size_t out = 0;
+    for (size_t i = 0; i < graph->nCalls; i++) {
+        if (out > 0 && graph->calls[out-1].from == graph->calls[i].from
+                && graph->calls[out-1].to == graph->calls[i].to)
+            graph->calls[out-1].nCalls += graph->calls[i].nCalls;
+        else
+            graph->calls[out++] = graph->calls[i];
+    }
+    graph->nCalls = graph->nMerged = out;
+}
+
+/*
+ * adding a call between two given phones, adding them if they do not exist
+ *
+ * returns 0 if OK, -1 if this is the same node (cannot connect with itself)
+ * or memory error
+ */
+int addCall(CGraph *graph, char *phone1, char *phone2)
+{
+    long id1 = internPhone(graph, phone1);
+    if (id1 == -1)
+        return -1;
+    long id2 = internPhone(graph, phone2);
+    if (id2 == -1 || id1 == id2)
+        return -1;
+
+    if (graph->nCalls == graph->callsCapacity) {
+        // merge first, grow only if merging freed less than a quarter
+        if (graph->nCalls > graph->nMerged)
+            mergeCalls(graph);
+        if (4 * graph->nCalls >= 3 * graph->callsCapacity) {
+            size_t capacity = graph->callsCapacity ? graph->callsCapacity / 2 * 3 : 4096;
+            CallTriple *calls = realloc(graph->calls, capacity * sizeof *calls);
+            if (calls == NULL)
+                return -1;
+            graph->calls = calls;
+            graph->callsCapacity = capacity;
+        }
+    }
+    CallTriple call = { id1 < id2 ? id1 : id2, id1 < id2 ? id2 : id1, 1 };
+    graph->calls[graph->nCalls++] = call;
+    return 0;
+}
+
+static int varintSize(unsigned value)
+{
+    int size = 1;
+    for (; value >= 0x80; value >>= 7)
+        size++;
+    return size;
+}
+
+static unsigned char *putVarint(unsigned char *p, unsigned value)
+{
+    for (; value >= 0x80; value >>= 7)
+        *p++ = (value & 0x7f) | 0x80;
+    *p++ = value;
+    return p;
+}
+
+static unsigned getVarint(const unsigned char **p)
+{
+    unsigned value = 0;
+    for (int shift = 0;; shift += 7) {
+        unsigned char byte = *(*p)++;
+        value |= (unsigned)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+}
+
+/*
+ * encode the merged calls into adjacency lists, call after all input is read
+ * The triples are sorted by (from, to), so one scan meets every node's
+ * smaller neighbors (as "to") before its larger ones (as "from"), each in
+ * increasing order: a first scan sizes the lists, a second one writes them.
+ * returns 0 if OK, -1 if memory error
+ */
+int buildCompressed(CGraph *graph)
+{
+    mergeCalls(graph);
+    size_t nNodes = graph->nNodes;
+    graph->offsets = calloc(nNodes + 1, sizeof *graph->offsets);
+    unsigned *last = calloc(nNodes + 1, sizeof *last);    // previous neighbor of each node
+    if (graph->offsets == NULL || last == NULL) {
+        free(last);
+        return -1;
+    }
+    for (size_t i = 0; i < graph->nCalls; i++) {
+        CallTriple *call = &graph->calls[i];
+        int countSize = varintSize(call->nCalls - 1);
+        graph->offsets[call->to + 1] += varintSize(call->from - last[call->to]) + countSize;
+        last[call->to] = call->from;
+        graph->offsets[call->from + 1] += varintSize(call->to - last[call->from]) + countSize;
+        last[call->from] = call->to;
+    }
+    for (size_t node = 0; node < nNodes; node++)
+        graph->offsets[node+1] += graph->offsets[node];
+
+    graph->adj = malloc(graph->offsets[nNodes] ? graph->offsets[nNodes] : 1);
+    if (graph->adj == NULL) {
+        free(last);
+        return -1;
+    }
+    // offsets[node] serves as node's write position, ending at the start of node+1
+    memset(last, 0, (nNodes + 1) * sizeof *last);
+    for (size_t i = 0; i < graph->nCalls; i++) {
+        CallTriple *call = &graph->calls[i];
+        unsigned char *p = putVarint(graph->adj + graph->offsets[call->to], call->from - last[call->to]);
+        graph->offsets[call->to] = putVarint(p, call->nCalls - 1) - graph->adj;
+        last[call->to] = call->from;
+        p = putVarint(graph->adj + graph->offsets[call->from], call->to - last[call->from]);
+        graph->offsets[call->from] = putVarint(p, call->nCalls - 1) - graph->adj;
+        last[call->from] = call->to;
+    }
+    memmove(graph->offsets + 1, graph->offsets, nNodes * sizeof *graph->offsets);
+    graph->offsets[0] = 0;
+    free(last);
+
+    // the triples are not needed any more
+    free(graph->calls);
+    graph->calls = NULL;
+    graph->nCalls = graph->callsCapacity = graph->nMerged = 0;
+
+    graph->phones = malloc((nNodes + 1) * sizeof *graph->phones);
+    if (graph->phones == NULL)
+        return -1;
+    for (size_t i = 0; i < graph->capacity; i++)
+        if (graph->keys[i] != 0)
+            graph->phones[graph->ids[i]] = graph->keys[i];
+
+    graph->stamp = calloc(nNodes + 1, sizeof *graph->stamp);
+    graph->queue = malloc((nNodes + 1) * sizeof *graph->queue);
+    graph->level = malloc((nNodes + 1) * sizeof *graph->level);
+    if (graph->stamp == NULL || graph->queue == NULL || graph->level == NULL)
+        return -1;
+    return 0;
+}
+
+/*
+ * free memory used by compressed graph
+ */
+void removeCGraph(CGraph *graph)
+{
+    free(graph->keys);
+    free(graph->ids);
+    free(graph->phones);
+    free(graph->calls);
+    free(graph->offsets);
+    free(graph->adj);
+    free(graph->stamp);
+    free(graph->queue);
+    free(graph->level);
+    free(graph->levelKeys);
+    free(graph);
+}
+
+/*
+ * same as talkedTimes(), decoding node1's neighbors until node2 or a larger id
+ */
+int cTalkedTimes(CGraph *graph, char *phone1, char *phone2)
+{
+    long id1 = findId(graph, phone1);
+    long id2 = findId(graph, phone2);
+    if (id1 == -1 || id2 == -1)
+        return -1;    // incorrect input
+
+    const unsigned char *p = graph->adj + graph->offsets[id1];
+    const unsigned char *end = graph->adj + graph->offsets[id1+1];
+    unsigned neighbor = 0;
+    while (p < end) {
+        neighbor += getVarint(&p);
+        unsigned nCalls = getVarint(&p) + 1;
+        if (neighbor == (unsigned)id2)
+            return nCalls;
+        if (neighbor > (unsigned)id2)
+            break;
+    }
+    return 0;
+}
+
+/*
+ * new stamp instead of clearing the visited marks
+ */
+static void newStamp(CGraph *graph)
+{
+    if (++graph->curStamp == 0) {
+        memset(graph->stamp, 0, graph->nNodes * sizeof *graph->stamp);
+        graph->curStamp = 1;
+    }
+}
+
+/*
+ * same as BFS(), over the compressed lists with an array queue
+ * returns -2 if a phone does not exist, -1 if no path,
+ * number of edges on shortest path otherwise
+ */
+int cBFS(CGraph *graph, char *startPhone, char *targetPhone)
+{
+    long start = findId(graph, startPhone);
+    long target = findId(graph, targetPhone);
+    if (start == -1 || target == -1)
+        return -2;
+    if (start == target)
+        return 0;
+
+    newStamp(graph);
+    size_t head = 0, tail = 0;
+    graph->queue[tail++] = start;
+    graph->level[start] = 0;
+    graph->stamp[start] = graph->curStamp;
+    while (head < tail) {
+        unsigned node = graph->queue[head++];
+        const unsigned char *p = graph->adj + graph->offsets[node];
+        const unsigned char *end = graph->adj + graph->offsets[node+1];
+        unsigned neighbor = 0;
+        while (p < end) {
+            neighbor += getVarint(&p);
+            getVarint(&p);    // nCalls, not needed here
+            if (graph->stamp[neighbor] == graph->curStamp)
+                continue;
+            graph->stamp[neighbor] = graph->curStamp;
+            graph->level[neighbor] = graph->level[node] + 1;
+            if (neighbor == (unsigned)target)
+                return graph->level[neighbor];
+            graph->queue[tail++] = neighbor;
+        }
+    }
+    return -1;
+}
+
+static int compareKeys(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * same as neighborhood(), with the BFS stamps as reached marks and the
+ * queue holding the levels; each complete level is copied to levelKeys
+ * as phone keys, sorted and printed
+ * returns -1 if the phone does not exist, -2 if memory error,
+ * number of phones printed otherwise
+ */
+long cNeighborhood(CGraph *graph, char *startPhone, int hops, int minCalls)
+{
+    long start = findId(graph, startPhone);
+    if (start == -1)
+        return -1;
+    if (graph->levelKeys == NULL) {
+        graph->levelKeys = malloc((graph->nNodes + 1) * sizeof *graph->levelKeys);
+        if (graph->levelKeys == NULL)
+            return -2;
+    }
+
+    newStamp(graph);
+    size_t levelStart = 0, levelEnd = 1, tail = 1;
+    graph->queue[0] = start;
+    graph->stamp[start] = graph->curStamp;
+    for (int hop = 1; hop <= hops && levelStart < levelEnd; hop++) {
+        for (size_t i = levelStart; i < levelEnd; i++) {
+            unsigned node = graph->queue[i];
+            const unsigned char *p = graph->adj + graph->offsets[node];
+            const unsigned char *end = graph->adj + graph->offsets[node+1];
+            unsigned neighbor = 0;
+            while (p < end) {
+                neighbor += getVarint(&p);
+                unsigned nCalls = getVarint(&p) + 1;
+                if (nCalls < (unsigned)minCalls || graph->stamp[neighbor] == graph->curStamp)
+                    continue;
+                graph->stamp[neighbor] = graph->curStamp;
+                graph->queue[tail++] = neighbor;
+            }
+        }
+
+        // level hop is complete
+        size_t n = tail - levelEnd;
+        for (size_t i = 0; i < n; i++)
+            graph->levelKeys[i] = graph->phones[graph->queue[levelEnd + i]];
+        qsort(graph->levelKeys, n, sizeof *graph->levelKeys, compareKeys);
+        for (size_t i = 0; i < n; i++) {
+            unsigned long long digits = graph->levelKeys[i] - 1;
+            printf("%03llu-%03llu-%04llu %d\n", digits / 10000000, digits / 10000 % 1000,
+                   digits % 10000, hop);
+        }
+        levelStart = levelEnd;
+        levelEnd = tail;
+    }
+    return tail - 1;
+}
 
 
-/* ----------------------- PART III -- INPUT PARSING AND MAIN() --------- */
+
+/* ----------------------- PART IV -- INPUT PARSING AND MAIN() --------- */
 
 /*
  * remove and leading and trailing spaces in input string
@@ -401,21 +925,69 @@ static int check_string(const char *s)
     return 0;
 }
 
+/*
+ * check neighborhood query format in trimmed string
+ *
+ * s must be of format:
+ * xxx-xxx-xxxx (any space/tab count) hops [(any space/tab count) minCalls]
+ * with hops >= 1 and minCalls >= 1, minCalls is 1 if not given
+ * return 0 if OK, setting *hops and *minCalls
+ * return -1 if fail
+ */
+static int check_hops(const char *s, int *hops, int *minCalls)
+{
+    const char *phone = "xxx-xxx-xxxx";
+
+    int i;
+    for (i = 0; phone[i]; i++)
+        if ((phone[i]=='x' && !isdigit(s[i])) || (phone[i]=='-' && s[i]!='-'))
+            return -1;
+
+    // numbers, each after at least one space
+    long numbers[2] = { 0, 1 };
+    int count;
+    for (count = 0; count < 2 && isspace(s[i]); count++) {
+        while (isspace(s[i]))
+            i++;
+        if (!isdigit(s[i]))
+            return -1;
+        char *end;
+        numbers[count] = strtol(&s[i], &end, 10);
+        if (numbers[count] < 1 || numbers[count] > INT_MAX)
+            return -1;
+        i = end - s;
+    }
+    if (count == 0 || s[i])
+        return -1;
+
+    *hops = numbers[0];
+    *minCalls = numbers[1];
+    return 0;
+}
+
 
 
 int main(int argc, char *argv[])
 {
     int return_status=0;
 
+    // compressed graph requested
+    int compressed = argc > 1 && strcmp(argv[1], "-c") == 0;
+    if (compressed) {
+        argc--;
+        argv++;
+    }
+
     // check CLI
     if (argc < 2) {
-        fprintf(stderr, "Usage: ./calls <file1> [file2] [file3] [...]\n");
+        fprintf(stderr, "Usage: ./calls [-c] <file1> [file2] [file3] [...]\n");
         exit(1);
     }
 
-    // make graph
-    Graph *graph = allocGraph();
-    if (graph == NULL) {
+    // make graph (only one of them is used)
+    Graph *graph = compressed ? NULL : allocGraph();
+    CGraph *cgraph = compressed ? allocCGraph() : NULL;
+    if (graph == NULL && cgraph == NULL) {
         fprintf(stderr, "Cannot create graph\n");
         exit(1);
     }
@@ -447,7 +1019,8 @@ int main(int argc, char *argv[])
             // get 2 phones from line, build edge on them
             char phone1[13], phone2[13];
             sscanf(buf, "%s %s", phone1, phone2);
-            if (addEdge(graph, phone1, phone2)==-1) {
+            int added = compressed ? addCall(cgraph, phone1, phone2) : addEdge(graph, phone1, phone2);
+            if (added==-1) {
                 fprintf(stderr, "reading %s: fail to add (%s,%s) call\n", 
                         *argv, phone1, phone2);
                 return_status = 1;    // nonfatal error
@@ -459,7 +1032,17 @@ int main(int argc, char *argv[])
     // fatal error -- no input files opened
     if (!at_least_one_opened) {
         fprintf(stderr, "No input file opened\n");
-        removeGraph(graph);
+        if (compressed)
+            removeCGraph(cgraph);
+        else
+            removeGraph(graph);
+        exit(1);
+    }
+
+    // encode compressed lists now that all calls are known
+    if (compressed && buildCompressed(cgraph) == -1) {
+        fprintf(stderr, "Cannot create graph\n");
+        removeCGraph(cgraph);
         exit(1);
     }
 
@@ -470,6 +1053,25 @@ int main(int argc, char *argv[])
         trim(buf);
         if (*buf=='\0')    // skip empty
             continue;
+
+        // neighborhood query
+        int hops, minCalls;
+        if (check_hops(buf, &hops, &minCalls) == 0) {
+            char phone[13];
+            sscanf(buf, "%12s", phone);
+            long found = compressed ? cNeighborhood(cgraph, phone, hops, minCalls)
+                                    : neighborhood(graph, phone, hops, minCalls);
+            if (found == -1) {    // no such phone
+                fprintf(stderr, "Does not exist: %s\n", phone);
+                return_status = 1;    // nonfatal error
+            } else if (found == -2) {
+                fprintf(stderr, "Error determining neighborhood: %s\n", phone);
+                return_status = 1;
+            } else
+                printf("%ld numbers within %d calls\n", found, hops);
+            continue;
+        }
+
         if (check_string(buf) == -1) {    // incorrect phone format
             fprintf(stderr, "incorrect format\n");
             return_status = 1;    // nonfatal error
@@ -481,12 +1083,14 @@ int main(int argc, char *argv[])
         sscanf(buf, "%s %s", phone1, phone2);
         
         // try to get direct connection 
-        int nTalk = talkedTimes(graph, phone1, phone2);
+        int nTalk = compressed ? cTalkedTimes(cgraph, phone1, phone2)
+                               : talkedTimes(graph, phone1, phone2);
         if (nTalk == -1) {    // no such phones
             fprintf(stderr, "One/both do not exist: %s, %s\n", phone1, phone2);
             return_status = 1;    // nonfatal error
         } else if (nTalk == 0) {    // nondirected -> use BFS
-            int nConnected = BFS(graph, phone1, phone2);
+            int nConnected = compressed ? cBFS(cgraph, phone1, phone2)
+                                        : BFS(graph, phone1, phone2);
             switch (nConnected) {
             case -2:    // fatal error (memory error), but consider notfatal as not tested
                 fprintf(stderr, "Error determining connected number: %s, %s\n", phone1, phone2);
@@ -507,6 +1111,9 @@ int main(int argc, char *argv[])
     }
          
 
-    removeGraph(graph);
+    if (compressed)
+        removeCGraph(cgraph);
+    else
+        removeGraph(graph);
     exit(return_status);
 }
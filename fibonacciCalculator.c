@@ -6,45 +6,1295 @@ Simple Fibonacci Calculator
 *******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
 
-//method to see if its square
-  int isSquare(int x)
-    {
-        float temp; 
-        float squareR;
-         squareR = x / 2;
-         temp = 0;
-         while(squareR != temp){
-    
-        temp = squareR;
-        
-        squareR = ( x/temp + temp) / 2;
-    }
-        
-       int s = ( x/temp + temp) / 2; 
-       return (s*s == x);
-       
-     }  
-     //method to return the calulation 
-   int isFib(int i)
-      {
-         return isSquare(5*i*i + 4) ||
-           isSquare(5*i*i - 4);
-     }
-    int main(void)
-    {   
-    
-	 int userInput;
-	 scanf("%d", &userInput);
-	  if (userInput>0)
-		{
-		 printf("%d is",userInput);
-		  if(isFib(userInput)==1){
-		        printf(" fib");
-		    }
-		    if(isFib(userInput)==0){
-		        printf(" not fib");
-		    }
-		} 
-		return 0;        
-   }
+#define FIB_COUNT 93
+#define BATCH 16
+
+#define BASE 1000000000u
+#define KARATSUBA_LIMIT 40      //limbs, below this schoolbook is faster
+#define NTT_LIMIT 1200          //limbs of the shorter operand, above this use the NTT
+#define NTT_MAX_SIZE (1u << 23) //largest transform all three primes support
+#define NTT_PARALLEL (1u << 15) //transforms at least this long run one thread per prime
+
+//every distinct Fibonacci number that fits in 64 bits, F(0) through F(93)
+static const uint64_t fibTable[FIB_COUNT] = {
+    0u, 1u, 2u, 3u, 5u, 8u, 13u, 21u, 34u, 55u, 89u, 144u, 233u, 377u, 610u, 987u, 1597u, 2584u,
+    4181u, 6765u, 10946u, 17711u, 28657u, 46368u, 75025u, 121393u, 196418u, 317811u, 514229u,
+    832040u, 1346269u, 2178309u, 3524578u, 5702887u, 9227465u, 14930352u, 24157817u, 39088169u,
+    63245986u, 102334155u, 165580141u, 267914296u, 433494437u, 701408733u, 1134903170u,
+    1836311903u, 2971215073u, 4807526976ull, 7778742049ull, 12586269025ull, 20365011074ull,
+    32951280099ull, 53316291173ull, 86267571272ull, 139583862445ull, 225851433717ull,
+    365435296162ull, 591286729879ull, 956722026041ull, 1548008755920ull, 2504730781961ull,
+    4052739537881ull, 6557470319842ull, 10610209857723ull, 17167680177565ull, 27777890035288ull,
+    44945570212853ull, 72723460248141ull, 117669030460994ull, 190392490709135ull,
+    308061521170129ull, 498454011879264ull, 806515533049393ull, 1304969544928657ull,
+    2111485077978050ull, 3416454622906707ull, 5527939700884757ull, 8944394323791464ull,
+    14472334024676221ull, 23416728348467685ull, 37889062373143906ull, 61305790721611591ull,
+    99194853094755497ull, 160500643816367088ull, 259695496911122585ull, 420196140727489673ull,
+    679891637638612258ull, 1100087778366101931ull, 1779979416004714189ull, 2880067194370816120ull,
+    4660046610375530309ull, 7540113804746346429ull, 12200160415121876738ull
+};
+
+//method to return the calulation, a branchless binary search of the table
+int isFib(uint64_t i)
+{
+    const uint64_t *base = fibTable;
+    size_t n = FIB_COUNT;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = base[half] <= i ? base + half : base;
+        n -= half;
+    }
+    return *base == i;
+}
+
+//same search for a whole block, the lanes step together so their loads overlap
+void isFibBatch(const uint64_t values[], int results[], size_t count)
+{
+    size_t pos[BATCH] = { 0 };
+    size_t n = FIB_COUNT;
+    while (n > 1) {
+        size_t half = n / 2;
+        for (size_t l = 0; l < count; l++) {
+            pos[l] += fibTable[pos[l] + half] <= values[l] ? half : 0;
+        }
+        n -= half;
+    }
+    for (size_t l = 0; l < count; l++) {
+        results[l] = fibTable[pos[l]] == values[l];
+    }
+}
+
+//method to read a decimal number, returns 0 if text is not one or does not fit
+int parseNumber(const char text[], uint64_t *value)
+{
+    uint64_t v = 0;
+    if (*text == '\0') {
+        return 0;
+    }
+    for (; *text != '\0'; text++) {
+        if (!isdigit((unsigned char)*text)) {
+            return 0;
+        }
+        unsigned digit = *text - '0';
+        if (v > (UINT64_MAX - digit) / 10) {
+            return 0;
+        }
+        v = v * 10 + digit;
+    }
+    *value = v;
+    return 1;
+}
+
+//method to read the next whitespace separated token, longer ones are cut and flagged
+int readToken(FILE *fp, char token[], size_t size, int *tooLong)
+{
+    int c;
+    while ((c = getc_unlocked(fp)) != EOF && isspace(c)) {
+    }
+    if (c == EOF) {
+        return 0;
+    }
+    size_t len = 0;
+    *tooLong = 0;
+    for (; c != EOF && !isspace(c); c = getc_unlocked(fp)) {
+        if (len + 1 < size) {
+            token[len++] = c;
+        } else {
+            *tooLong = 1;
+        }
+    }
+    token[len] = '\0';
+    return 1;
+}
+
+void printBatch(const uint64_t values[], size_t count)
+{
+    int results[BATCH];
+    isFibBatch(values, results, count);
+    for (size_t l = 0; l < count; l++) {
+        char line[48];
+        char *p = line + sizeof line;
+        const char *tail = results[l] ? " is fib\n" : " is not fib\n";
+        size_t tailLen = strlen(tail);
+        p -= tailLen;
+        memcpy(p, tail, tailLen);
+        uint64_t v = values[l];
+        do {
+            *--p = '0' + v % 10;
+            v /= 10;
+        } while (v != 0);
+        fwrite_unlocked(p, 1, line + sizeof line - p, stdout);
+    }
+}
+
+//batch mode: one "N is fib" or "N is not fib" line per number in the input
+int classifyAll(FILE *fp)
+{
+    static char out[1 << 16];
+    setvbuf(stdout, out, _IOFBF, sizeof out);
+    uint64_t values[BATCH];
+    size_t count = 0;
+    int badNumbers = 0;
+    char token[32];
+    int tooLong;
+    while (readToken(fp, token, sizeof token, &tooLong)) {
+        if (tooLong || !parseNumber(token, &values[count])) {
+            fprintf(stderr, "Bad number: %s%s\n", token, tooLong ? "..." : "");
+            badNumbers++;
+            continue;
+        }
+        if (++count == BATCH) {
+            printBatch(values, count);
+            count = 0;
+        }
+    }
+    printBatch(values, count);
+    fflush(stdout);
+    return badNumbers > 0;
+}
+
+/*
+ * big numbers are little endian arrays of base 10^9 limbs, so they print
+ * in decimal without a conversion. len is 0 for zero and there are no
+ * leading zero limbs.
+ */
+typedef struct bigNum
+{
+    uint32_t *limb;
+    size_t len;
+} bigNum;
+
+void memoryError()
+{
+    printf("ERROR: Memory allocation failed\n");
+    exit(1);
+}
+
+uint32_t *newLimbs(size_t count)
+{
+    uint32_t *limbs = calloc(count ? count : 1, sizeof(uint32_t));
+    if (limbs == NULL) {
+        memoryError();
+    }
+    return limbs;
+}
+
+size_t trimLen(const uint32_t *limbs, size_t len)
+{
+    while (len > 0 && limbs[len - 1] == 0) {
+        len--;
+    }
+    return len;
+}
+
+bigNum bigFromSmall(uint64_t v)
+{
+    bigNum r = { newLimbs(3), 0 };
+    while (v != 0) {
+        r.limb[r.len++] = v % BASE;
+        v /= BASE;
+    }
+    return r;
+}
+
+void bigFree(bigNum *a)
+{
+    free(a->limb);
+    a->limb = NULL;
+    a->len = 0;
+}
+
+int compareLimbs(const uint32_t *a, size_t na, const uint32_t *b, size_t nb)
+{
+    if (na != nb) {
+        return na < nb ? -1 : 1;
+    }
+    while (na-- > 0) {
+        if (a[na] != b[na]) {
+            return a[na] < b[na] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+//r += a, r must have room for the carry
+void addInto(uint32_t *r, const uint32_t *a, size_t na)
+{
+    uint32_t carry = 0;
+    size_t i;
+    for (i = 0; i < na; i++) {
+        uint32_t sum = r[i] + a[i] + carry;
+        carry = sum >= BASE;
+        r[i] = carry ? sum - BASE : sum;
+    }
+    for (; carry; i++) {
+        uint32_t sum = r[i] + 1;
+        carry = sum == BASE;
+        r[i] = carry ? 0 : sum;
+    }
+}
+
+//r -= a, r must not be smaller than a
+void subInto(uint32_t *r, const uint32_t *a, size_t na)
+{
+    uint32_t borrow = 0;
+    size_t i;
+    for (i = 0; i < na; i++) {
+        uint32_t sub = a[i] + borrow;
+        borrow = r[i] < sub;
+        r[i] = borrow ? r[i] + BASE - sub : r[i] - sub;
+    }
+    for (; borrow; i++) {
+        borrow = r[i] == 0;
+        r[i] = borrow ? BASE - 1 : r[i] - 1;
+    }
+}
+
+bigNum bigAdd(bigNum a, bigNum b)
+{
+    size_t len = (a.len > b.len ? a.len : b.len) + 1;
+    bigNum r = { newLimbs(len), 0 };
+    memcpy(r.limb, a.limb, a.len * sizeof(uint32_t));
+    addInto(r.limb, b.limb, b.len);
+    r.len = trimLen(r.limb, len);
+    return r;
+}
+
+//a - b for a >= b
+bigNum bigSub(bigNum a, bigNum b)
+{
+    bigNum r = { newLimbs(a.len), 0 };
+    memcpy(r.limb, a.limb, a.len * sizeof(uint32_t));
+    subInto(r.limb, b.limb, b.len);
+    r.len = trimLen(r.limb, a.len);
+    return r;
+}
+
+void mulLimbs(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *r);
+
+//r[0 .. na+nb) = a * b, r zeroed by the caller
+void mulSchoolbook(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *r)
+{
+    for (size_t i = 0; i < na; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < nb; j++) {
+            uint64_t cur = r[i + j] + (uint64_t)a[i] * b[j] + carry;
+            carry = cur / BASE;
+            r[i + j] = cur % BASE;
+        }
+        r[i + nb] = carry;
+    }
+}
+
+//na >= nb > na / 2, a = a1 B^m + a0 and b = b1 B^m + b0
+void mulKaratsuba(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *r)
+{
+    size_t m = na / 2;
+    size_t sa = na - m + 1, sb = (nb - m > m ? nb - m : m) + 1;
+    uint32_t *sumA = newLimbs(sa), *sumB = newLimbs(sb), *mid = newLimbs(sa + sb);
+    memcpy(sumA, a, m * sizeof(uint32_t));
+    addInto(sumA, a + m, na - m);
+    memcpy(sumB, b, m * sizeof(uint32_t));
+    addInto(sumB, b + m, nb - m);
+    mulLimbs(sumA, trimLen(sumA, sa), sumB, trimLen(sumB, sb), mid);
+
+    mulLimbs(a, m, b, m, r);
+    mulLimbs(a + m, na - m, b + m, nb - m, r + 2 * m);
+    size_t midLen = trimLen(mid, sa + sb);
+    subInto(mid, r, trimLen(r, 2 * m));
+    subInto(mid, r + 2 * m, trimLen(r + 2 * m, na + nb - 2 * m));
+    addInto(r + m, mid, trimLen(mid, midLen));
+    free(sumA);
+    free(sumB);
+    free(mid);
+}
+
+/*
+ * number theoretic transform modulo three primes of the form c 2^k + 1.
+ * Every coefficient of a product of base 10^9 limbs is below 2^22 * 10^18,
+ * which the three primes together cover, so the Chinese remainder theorem
+ * recovers it exactly.
+ */
+static const uint32_t nttPrime[3] = { 998244353u, 167772161u, 469762049u };
+
+static inline uint32_t mulMod(uint32_t a, uint32_t b, uint32_t p)
+{
+    return (uint64_t)a * b % p;
+}
+
+uint32_t powMod(uint32_t base, uint64_t e, uint32_t p)
+{
+    uint32_t result = 1;
+    for (; e != 0; e >>= 1) {
+        if (e & 1) {
+            result = mulMod(result, base, p);
+        }
+        base = mulMod(base, base, p);
+    }
+    return result;
+}
+
+//always inlined so each prime gets its own copy with a constant modulus
+static inline __attribute__((always_inline)) void nttPass(uint32_t *x, size_t n, int invert, const uint32_t p)
+{
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            uint32_t t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        //3 generates the multiplicative group of all three primes
+        uint32_t w = powMod(3, (p - 1) / len, p);
+        if (invert) {
+            w = powMod(w, p - 2, p);
+        }
+        size_t half = len / 2;
+        uint32_t *roots = malloc(half * sizeof(uint32_t));
+        if (roots == NULL) {
+            memoryError();
+        }
+        roots[0] = 1;
+        for (size_t k = 1; k < half; k++) {
+            roots[k] = mulMod(roots[k - 1], w, p);
+        }
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t k = 0; k < half; k++) {
+                uint32_t u = x[i + k], v = mulMod(x[i + k + half], roots[k], p);
+                x[i + k] = u + v >= p ? u + v - p : u + v;
+                x[i + k + half] = u >= v ? u - v : u + p - v;
+            }
+        }
+        free(roots);
+    }
+    if (invert) {
+        uint32_t nInverse = powMod(n % p, p - 2, p);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = mulMod(x[i], nInverse, p);
+        }
+    }
+}
+
+void ntt(uint32_t *x, size_t n, int invert, int prime)
+{
+    switch (prime) {
+    case 0:
+        nttPass(x, n, invert, 998244353u);
+        break;
+    case 1:
+        nttPass(x, n, invert, 167772161u);
+        break;
+    default:
+        nttPass(x, n, invert, 469762049u);
+        break;
+    }
+}
+
+typedef struct nttJob
+{
+    const uint32_t *a, *b;
+    size_t na, nb, size;
+    int prime;
+    uint32_t *result;   //the cyclic convolution of a and b modulo the prime
+} nttJob;
+
+void *convolve(void *arg)
+{
+    nttJob *job = arg;
+    uint32_t p = nttPrime[job->prime];
+    uint32_t *x = newLimbs(job->size);
+    for (size_t i = 0; i < job->na; i++) {
+        x[i] = job->a[i] % p;
+    }
+    ntt(x, job->size, 0, job->prime);
+    if (job->a == job->b && job->na == job->nb) {
+        //squaring needs one forward transform
+        for (size_t i = 0; i < job->size; i++) {
+            x[i] = mulMod(x[i], x[i], p);
+        }
+    } else {
+        uint32_t *y = newLimbs(job->size);
+        for (size_t i = 0; i < job->nb; i++) {
+            y[i] = job->b[i] % p;
+        }
+        ntt(y, job->size, 0, job->prime);
+        for (size_t i = 0; i < job->size; i++) {
+            x[i] = mulMod(x[i], y[i], p);
+        }
+        free(y);
+    }
+    ntt(x, job->size, 1, job->prime);
+    job->result = x;
+    return NULL;
+}
+
+void mulNtt(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *r)
+{
+    size_t size = 1;
+    while (size < na + nb) {
+        size <<= 1;
+    }
+    nttJob jobs[3];
+    pthread_t threads[3];
+    int threaded[3] = { 0 };
+    for (int k = 0; k < 3; k++) {
+        nttJob job = { a, b, na, nb, size, k, NULL };
+        jobs[k] = job;
+        if (k > 0 && size >= NTT_PARALLEL) {
+            threaded[k] = pthread_create(&threads[k], NULL, convolve, &jobs[k]) == 0;
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        if (!threaded[k]) {
+            convolve(&jobs[k]);
+        }
+    }
+    for (int k = 1; k < 3; k++) {
+        if (threaded[k]) {
+            pthread_join(threads[k], NULL);
+        }
+    }
+
+    uint32_t p0 = nttPrime[0], p1 = nttPrime[1], p2 = nttPrime[2];
+    uint32_t inv01 = powMod(p0 % p1, p1 - 2, p1);
+    uint32_t inv012 = powMod(mulMod(p0 % p2, p1 % p2, p2), p2 - 2, p2);
+    unsigned __int128 carry = 0;
+    for (size_t i = 0; i < na + nb; i++) {
+        uint32_t r0 = jobs[0].result[i], r1 = jobs[1].result[i], r2 = jobs[2].result[i];
+        uint32_t t1 = mulMod((r1 + p1 - r0 % p1) % p1, inv01, p1);
+        uint32_t t2 = (r2 + 2 * (uint64_t)p2 - r0 % p2 - mulMod(t1, p0 % p2, p2)) % p2;
+        t2 = mulMod(t2, inv012, p2);
+        unsigned __int128 value = r0 + (uint64_t)t1 * p0 + (unsigned __int128)t2 * ((uint64_t)p0 * p1) + carry;
+        carry = value / BASE;
+        r[i] = value % BASE;
+    }
+    for (int k = 0; k < 3; k++) {
+        free(jobs[k].result);
+    }
+}
+
+//r[0 .. na+nb) = a * b, r zeroed by the caller
+void mulLimbs(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *r)
+{
+    if (na < nb) {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        size_t n = na;
+        na = nb;
+        nb = n;
+    }
+    if (nb == 0) {
+        return;
+    }
+    if (nb < KARATSUBA_LIMIT) {
+        mulSchoolbook(a, na, b, nb, r);
+    } else if (nb >= NTT_LIMIT && na + nb <= NTT_MAX_SIZE) {
+        mulNtt(a, na, b, nb, r);
+    } else if (na >= 2 * nb) {
+        //unbalanced: multiply b by one nb limb slice of a at a time
+        uint32_t *part = newLimbs(2 * nb);
+        for (size_t i = 0; i < na; i += nb) {
+            size_t len = na - i < nb ? na - i : nb;
+            memset(part, 0, 2 * nb * sizeof(uint32_t));
+            mulLimbs(a + i, len, b, nb, part);
+            addInto(r + i, part, trimLen(part, len + nb));
+        }
+        free(part);
+    } else {
+        mulKaratsuba(a, na, b, nb, r);
+    }
+}
+
+bigNum bigMul(bigNum a, bigNum b)
+{
+    bigNum r = { newLimbs(a.len + b.len), 0 };
+    mulLimbs(a.limb, a.len, b.limb, b.len, r.limb);
+    r.len = trimLen(r.limb, a.len + b.len);
+    return r;
+}
+
+//a / b by long division (Knuth algorithm D), b must not be zero
+bigNum bigDiv(bigNum a, bigNum b)
+{
+    if (compareLimbs(a.limb, a.len, b.limb, b.len) < 0) {
+        return bigFromSmall(0);
+    }
+    size_t n = b.len, m = a.len - n;
+    bigNum q = { newLimbs(m + 1), 0 };
+    if (n == 1) {
+        uint64_t rest = 0;
+        for (size_t i = a.len; i-- > 0;) {
+            uint64_t cur = rest * BASE + a.limb[i];
+            q.limb[i] = cur / b.limb[0];
+            rest = cur % b.limb[0];
+        }
+        q.len = trimLen(q.limb, m + 1);
+        return q;
+    }
+    //scale both so the top limb of the divisor is at least BASE / 2
+    uint32_t d = BASE / (b.limb[n - 1] + 1);
+    uint32_t *u = newLimbs(a.len + 1), *v = newLimbs(n + 1);
+    bigNum scale = bigFromSmall(d);
+    mulSchoolbook(a.limb, a.len, scale.limb, scale.len, u);
+    mulSchoolbook(b.limb, b.len, scale.limb, scale.len, v);
+    bigFree(&scale);
+    for (size_t j = m + 1; j-- > 0;) {
+        uint64_t top = (uint64_t)u[j + n] * BASE + u[j + n - 1];
+        uint64_t qhat = top / v[n - 1], rhat = top % v[n - 1];
+        while (qhat >= BASE || qhat * v[n - 2] > rhat * BASE + u[j + n - 2]) {
+            qhat--;
+            rhat += v[n - 1];
+            if (rhat >= BASE) {
+                break;
+            }
+        }
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t product = qhat * v[i] + carry;
+            carry = product / BASE;
+            int64_t t = (int64_t)u[i + j] - (int64_t)(product % BASE) - borrow;
+            borrow = t < 0;
+            u[i + j] = t < 0 ? t + BASE : t;
+        }
+        int64_t t = (int64_t)u[j + n] - (int64_t)carry - borrow;
+        if (t < 0) {
+            //qhat was one too large, add the divisor back
+            qhat--;
+            uint32_t c = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint32_t sum = u[i + j] + v[i] + c;
+                c = sum >= BASE;
+                u[i + j] = c ? sum - BASE : sum;
+            }
+            t += c;
+        }
+        u[j + n] = t;
+        q.limb[j] = qhat;
+    }
+    free(u);
+    free(v);
+    q.len = trimLen(q.limb, m + 1);
+    return q;
+}
+
+//floor of the square root, from the root of the top half and Newton steps down to it
+bigNum bigSqrt(bigNum a)
+{
+    if (a.len <= 2) {
+        uint64_t v = a.len == 0 ? 0 : a.limb[0] + (a.len == 2 ? (uint64_t)a.limb[1] * BASE : 0);
+        uint64_t x = v, y = (v + 1) / 2;
+        while (y < x) {
+            x = y;
+            y = (x + v / x) / 2;
+        }
+        return bigFromSmall(x);
+    }
+    size_t k = a.len / 4 > 0 ? a.len / 4 : 1;
+    bigNum high = { a.limb + 2 * k, a.len - 2 * k };
+    bigNum root = bigSqrt(high);
+    bigNum one = bigFromSmall(1);
+    bigNum up = bigAdd(root, one);
+    //(root + 1) B^k is above the square root of a, so Newton's steps go down to it
+    bigNum x = { newLimbs(up.len + k), up.len + k };
+    memcpy(x.limb + k, up.limb, up.len * sizeof(uint32_t));
+    bigFree(&root);
+    bigFree(&up);
+    while (1) {
+        bigNum quotient = bigDiv(a, x);
+        bigNum sum = bigAdd(x, quotient);
+        bigNum two = bigFromSmall(2);
+        bigNum y = bigDiv(sum, two);
+        bigFree(&quotient);
+        bigFree(&sum);
+        bigFree(&two);
+        if (compareLimbs(y.limb, y.len, x.limb, x.len) >= 0) {
+            bigFree(&y);
+            break;
+        }
+        bigFree(&x);
+        x = y;
+    }
+    bigFree(&one);
+    return x;
+}
+
+int bigIsSquare(bigNum a)
+{
+    bigNum root = bigSqrt(a);
+    bigNum square = bigMul(root, root);
+    int result = compareLimbs(square.limb, square.len, a.limb, a.len) == 0;
+    bigFree(&root);
+    bigFree(&square);
+    return result;
+}
+
+//method to see if a number of any size is Fibonacci: 5n^2 + 4 or 5n^2 - 4 is a square
+int bigIsFib(bigNum n)
+{
+    bigNum five = bigFromSmall(5), four = bigFromSmall(4);
+    bigNum square = bigMul(n, n);
+    bigNum m = bigMul(square, five);
+    bigNum plus = bigAdd(m, four);
+    int result = bigIsSquare(plus);
+    if (!result && compareLimbs(m.limb, m.len, four.limb, four.len) >= 0) {
+        bigNum minus = bigSub(m, four);
+        result = bigIsSquare(minus);
+        bigFree(&minus);
+    }
+    bigFree(&five);
+    bigFree(&four);
+    bigFree(&square);
+    bigFree(&m);
+    bigFree(&plus);
+    return result;
+}
+
+/*
+ * fast doubling from the top bit of n down:
+ *   F(2k)   = F(k) (2 F(k+1) - F(k))
+ *   F(2k+1) = F(k)^2 + F(k+1)^2
+ */
+bigNum bigFib(uint64_t n)
+{
+    bigNum a = bigFromSmall(0), b = bigFromSmall(1);
+    int bit = 63;
+    while (bit >= 0 && !(n >> bit & 1)) {
+        bit--;
+    }
+    for (; bit >= 0; bit--) {
+        bigNum twiceB = bigAdd(b, b);
+        bigNum diff = bigSub(twiceB, a);
+        bigNum c = bigMul(a, diff);
+        bigNum a2 = bigMul(a, a);
+        bigNum b2 = bigMul(b, b);
+        bigNum d = bigAdd(a2, b2);
+        bigFree(&twiceB);
+        bigFree(&diff);
+        bigFree(&a2);
+        bigFree(&b2);
+        bigFree(&a);
+        bigFree(&b);
+        if (n >> bit & 1) {
+            a = d;
+            b = bigAdd(c, d);
+            bigFree(&c);
+        } else {
+            a = c;
+            b = d;
+        }
+    }
+    bigFree(&b);
+    return a;
+}
+
+void bigPrint(bigNum a)
+{
+    if (a.len == 0) {
+        printf("0");
+        return;
+    }
+    printf("%u", a.limb[a.len - 1]);
+    for (size_t i = a.len - 1; i-- > 0;) {
+        printf("%09u", a.limb[i]);
+    }
+}
+
+//method to read one decimal number of any length from fp, returns 0 if there is none
+int bigRead(FILE *fp, bigNum *a)
+{
+    size_t len = 0, capacity = 1 << 12;
+    char *text = malloc(capacity);
+    if (text == NULL) {
+        memoryError();
+    }
+    int c;
+    while ((c = getc_unlocked(fp)) != EOF && isspace(c)) {
+    }
+    for (; c != EOF && !isspace(c); c = getc_unlocked(fp)) {
+        if (!isdigit(c)) {
+            free(text);
+            return 0;
+        }
+        if (len == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+            if (text == NULL) {
+                memoryError();
+            }
+        }
+        text[len++] = c;
+    }
+    if (len == 0) {
+        free(text);
+        return 0;
+    }
+    size_t limbs = (len + 8) / 9;
+    a->limb = newLimbs(limbs);
+    for (size_t i = 0; i < limbs; i++) {
+        size_t end = len - 9 * i, start = end >= 9 ? end - 9 : 0;
+        uint32_t v = 0;
+        for (size_t j = start; j < end; j++) {
+            v = v * 10 + (text[j] - '0');
+        }
+        a->limb[i] = v;
+    }
+    a->len = trimLen(a->limb, limbs);
+    free(text);
+    return 1;
+}
+
+/*
+ * F(n) mod m for 64-bit m. m = 2^s * odd: the odd part is done in
+ * Montgomery form, the 2^s part with plain wrapping arithmetic, and the
+ * two are joined with the Chinese remainder theorem. n is first reduced
+ * modulo the Pisano period of m, the period of F mod m.
+ */
+typedef unsigned __int128 u128;
+
+typedef struct modulus
+{
+    uint64_t m;
+    uint64_t odd;       //m without its factors of two
+    uint64_t mask;      //2^s - 1
+    uint64_t inv;       //odd^-1 mod 2^64
+    uint64_t one;       //2^64 mod odd, 1 in Montgomery form
+    uint64_t r2;        //2^128 mod odd
+} modulus;
+
+void initModulus(modulus *mod, uint64_t m)
+{
+    int shift = __builtin_ctzll(m);
+    mod->m = m;
+    mod->odd = m >> shift;
+    mod->mask = ((uint64_t)1 << shift) - 1;
+    uint64_t inv = mod->odd;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - mod->odd * inv;
+    }
+    mod->inv = inv;
+    mod->one = -mod->odd % mod->odd;
+    mod->r2 = (u128)mod->one * mod->one % mod->odd;
+}
+
+//a * b / 2^64 mod odd
+static inline uint64_t montMul(uint64_t a, uint64_t b, const modulus *mod)
+{
+    u128 t = (u128)a * b;
+    uint64_t q = (uint64_t)t * mod->inv;
+    uint64_t high = t >> 64, qHigh = ((u128)q * mod->odd) >> 64;
+    return high >= qHigh ? high - qHigh : high - qHigh + mod->odd;
+}
+
+static inline uint64_t addMod(uint64_t a, uint64_t b, uint64_t n)
+{
+    uint64_t s = a + b;
+    return s < a || s >= n ? s - n : s;
+}
+
+static inline uint64_t subMod(uint64_t a, uint64_t b, uint64_t n)
+{
+    return a >= b ? a - b : a - b + n;
+}
+
+uint64_t toMont(uint64_t x, const modulus *mod)
+{
+    return montMul(x % mod->odd, mod->r2, mod);
+}
+
+uint64_t montPow(uint64_t base, u128 e, const modulus *mod)
+{
+    uint64_t result = mod->one;
+    for (; e != 0; e >>= 1) {
+        if (e & 1) {
+            result = montMul(result, base, mod);
+        }
+        base = montMul(base, base, mod);
+    }
+    return result;
+}
+
+//F(n) and F(n+1) mod m by fast doubling
+void fibPair(u128 n, const modulus *mod, uint64_t *f, uint64_t *g)
+{
+    int bit = 127;
+    while (bit >= 0 && !(n >> bit & 1)) {
+        bit--;
+    }
+    uint64_t a = 0, b = mod->one, odd = mod->odd;
+    uint64_t a2 = 0, b2 = 1;
+    for (int i = bit; i >= 0; i--) {
+        uint64_t c = montMul(a, subMod(addMod(b, b, odd), a, odd), mod);
+        uint64_t d = addMod(montMul(a, a, mod), montMul(b, b, mod), odd);
+        uint64_t c2 = a2 * (2 * b2 - a2), d2 = a2 * a2 + b2 * b2;
+        if (n >> i & 1) {
+            a = d;
+            b = addMod(c, d, odd);
+            a2 = d2;
+            b2 = c2 + d2;
+        } else {
+            a = c;
+            b = d;
+            a2 = c2;
+            b2 = d2;
+        }
+    }
+    //back out of Montgomery form, then x = odd part + odd * t with x = 2^s part mod 2^s
+    a = montMul(a, 1, mod);
+    b = montMul(b, 1, mod);
+    *f = a + odd * ((a2 - a) * mod->inv & mod->mask);
+    *g = b + odd * ((b2 - b) * mod->inv & mod->mask);
+}
+
+int isPrime64(uint64_t n)
+{
+    static const uint64_t small[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    for (size_t i = 0; i < sizeof small / sizeof small[0]; i++) {
+        if (n % small[i] == 0) {
+            return n == small[i];
+        }
+    }
+    if (n < 41 * 41) {
+        return n > 1;
+    }
+    //these bases decide every n below 2^64
+    static const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+    modulus mod;
+    initModulus(&mod, n);
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+    uint64_t minusOne = n - mod.one;
+    for (size_t i = 0; i < sizeof bases / sizeof bases[0]; i++) {
+        if (bases[i] % n == 0) {
+            continue;
+        }
+        uint64_t x = montPow(toMont(bases[i], &mod), d, &mod);
+        if (x == mod.one || x == minusOne) {
+            continue;
+        }
+        int witness = 1;
+        for (int r = 1; r < s && witness; r++) {
+            x = montMul(x, x, &mod);
+            witness = x != minusOne;
+        }
+        if (witness) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint64_t gcd64(uint64_t a, uint64_t b)
+{
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+//a nontrivial factor of an odd composite n, by Pollard's rho with Brent's cycle finding
+uint64_t findFactor(uint64_t n)
+{
+    modulus mod;
+    initModulus(&mod, n);
+    for (uint64_t c = 1;; c++) {
+        uint64_t cm = toMont(c, &mod);
+        uint64_t x, y = toMont(2, &mod), ys = y, q = mod.one, g = 1;
+        for (size_t r = 1; g == 1; r *= 2) {
+            x = y;
+            for (size_t i = 0; i < r; i++) {
+                y = addMod(montMul(y, y, &mod), cm, n);
+            }
+            for (size_t k = 0; k < r && g == 1; k += 128) {
+                ys = y;
+                for (size_t i = 0; i < 128 && i < r - k; i++) {
+                    y = addMod(montMul(y, y, &mod), cm, n);
+                    q = montMul(q, subMod(x, y, n), &mod);
+                }
+                g = gcd64(q, n);
+            }
+        }
+        if (g == n) {
+            //the batch overshot, step through it one at a time
+            do {
+                ys = addMod(montMul(ys, ys, &mod), cm, n);
+                g = gcd64(subMod(x, ys, n), n);
+            } while (g == 1);
+        }
+        if (g != n) {
+            return g;
+        }
+    }
+}
+
+//appends the prime factors of n, with repeats, to factors
+void factor64(uint64_t n, uint64_t factors[], int *count)
+{
+    for (uint64_t p = 2; p < 64 && p * p <= n; p++) {
+        while (n % p == 0) {
+            factors[(*count)++] = p;
+            n /= p;
+        }
+    }
+    if (n == 1) {
+        return;
+    }
+    if (isPrime64(n)) {
+        factors[(*count)++] = n;
+        return;
+    }
+    uint64_t d = findFactor(n);
+    factor64(d, factors, count);
+    factor64(n / d, factors, count);
+}
+
+/*
+ * period of F mod a prime p: 3 for 2 and 20 for 5, otherwise a divisor of
+ * p - 1 when p = +-1 mod 10 and of 2(p + 1) when p = +-3 mod 10
+ */
+u128 pisanoPrime(uint64_t p)
+{
+    if (p == 2) {
+        return 3;
+    }
+    if (p == 5) {
+        return 20;
+    }
+    uint64_t factors[130];
+    int count = 0;
+    u128 period;
+    if (p % 10 == 1 || p % 10 == 9) {
+        period = p - 1;
+        factor64(p - 1, factors, &count);
+    } else {
+        period = (u128)2 * (p + 1);
+        factors[count++] = 2;
+        factor64(p + 1, factors, &count);
+    }
+    modulus mod;
+    initModulus(&mod, p);
+    for (int i = 0; i < count; i++) {
+        while (period % factors[i] == 0) {
+            uint64_t f, g;
+            fibPair(period / factors[i], &mod, &f, &g);
+            if (f != 0 || g != 1) {
+                break;
+            }
+            period /= factors[i];
+        }
+    }
+    return period;
+}
+
+int compareFactors(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+//lcm over p^k in m of p^(k-1) times the period of p (no prime is known
+//where p^2 has the same period as p), at most 6m so it fits in 128 bits
+u128 pisano(uint64_t m)
+{
+    uint64_t factors[64];
+    int count = 0;
+    factor64(m, factors, &count);
+    qsort(factors, count, sizeof(uint64_t), compareFactors);
+    u128 period = 1;
+    for (int i = 0; i < count;) {
+        u128 part = pisanoPrime(factors[i]);
+        int j = i + 1;
+        for (; j < count && factors[j] == factors[i]; j++) {
+            part *= factors[i];
+        }
+        u128 a = period, b = part;
+        while (b != 0) {
+            u128 t = a % b;
+            a = b;
+            b = t;
+        }
+        period = period / a * part;
+        i = j;
+    }
+    return period;
+}
+
+//periods already found, shared by all the workers
+typedef struct pisanoCache
+{
+    uint64_t *keys;     //0 marks a free slot, every modulus is at least 1
+    u128 *periods;
+    size_t capacity;
+    size_t count;
+    pthread_mutex_t lock;
+} pisanoCache;
+
+size_t cacheSlot(const pisanoCache *cache, uint64_t m)
+{
+    size_t slot = (m * 0x9e3779b97f4a7c15ull >> 32) & (cache->capacity - 1);
+    while (cache->keys[slot] != 0 && cache->keys[slot] != m) {
+        slot = (slot + 1) & (cache->capacity - 1);
+    }
+    return slot;
+}
+
+void cacheGrow(pisanoCache *cache)
+{
+    uint64_t *keys = cache->keys;
+    u128 *periods = cache->periods;
+    size_t old = cache->capacity;
+    cache->capacity = old ? old * 2 : 64;
+    cache->keys = calloc(cache->capacity, sizeof(uint64_t));
+    cache->periods = malloc(cache->capacity * sizeof(u128));
+    if (cache->keys == NULL || cache->periods == NULL) {
+        memoryError();
+    }
+    for (size_t i = 0; i < old; i++) {
+        if (keys[i] != 0) {
+            size_t slot = cacheSlot(cache, keys[i]);
+            cache->keys[slot] = keys[i];
+            cache->periods[slot] = periods[i];
+        }
+    }
+    free(keys);
+    free(periods);
+}
+
+u128 cachedPisano(pisanoCache *cache, uint64_t m)
+{
+    pthread_mutex_lock(&cache->lock);
+    size_t slot = cacheSlot(cache, m);
+    int found = cache->keys[slot] == m;
+    u128 period = found ? cache->periods[slot] : 0;
+    pthread_mutex_unlock(&cache->lock);
+    if (found) {
+        return period;
+    }
+    //computed outside the lock, two workers may both find the same period
+    period = pisano(m);
+    pthread_mutex_lock(&cache->lock);
+    if (2 * (cache->count + 1) > cache->capacity) {
+        cacheGrow(cache);
+    }
+    slot = cacheSlot(cache, m);
+    if (cache->keys[slot] == 0) {
+        cache->keys[slot] = m;
+        cache->periods[slot] = period;
+        cache->count++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return period;
+}
+
+typedef struct modQuery
+{
+    char *n;            //decimal digits, any length, NULL for a malformed line
+    uint64_t m;
+    uint64_t result;
+} modQuery;
+
+typedef struct modBatch
+{
+    modQuery *queries;
+    size_t count;
+    size_t next;        //next query to hand out
+    pisanoCache cache;
+} modBatch;
+
+void *modWorker(void *arg)
+{
+    modBatch *batch = arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count) {
+        modQuery *query = &batch->queries[i];
+        if (query->n == NULL) {
+            continue;
+        }
+        u128 period = cachedPisano(&batch->cache, query->m), n = 0;
+        for (const char *digit = query->n; *digit != '\0'; digit++) {
+            n = (n * 10 + (*digit - '0')) % period;
+        }
+        modulus mod;
+        initModulus(&mod, query->m);
+        uint64_t next;
+        fibPair(n, &mod, &query->result, &next);
+    }
+    return NULL;
+}
+
+//method to read one "n m" query per line, returns 0 for a malformed line
+int parseQuery(char *line, modQuery *query)
+{
+    query->n = NULL;
+    char *n = strtok(line, " \t\r\n");
+    char *m = strtok(NULL, " \t\r\n");
+    if (n == NULL || m == NULL || strtok(NULL, " \t\r\n") != NULL ||
+        !parseNumber(m, &query->m) || query->m == 0) {
+        return 0;
+    }
+    for (const char *digit = n; *digit != '\0'; digit++) {
+        if (!isdigit((unsigned char)*digit)) {
+            return 0;
+        }
+    }
+    query->n = strdup(n);
+    if (query->n == NULL) {
+        memoryError();
+    }
+    return 1;
+}
+
+//modular mode: F(n) mod m for every "n m" line of fp, in input order.
+//Blank lines are skipped, a malformed line prints "error" in its place
+int fibModAll(FILE *fp, int numThreads)
+{
+    modBatch batch = { NULL, 0, 0, { NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER } };
+    size_t capacity = 0;
+    int badQueries = 0;
+    char *line = NULL;
+    size_t lineSize = 0;
+    while (getline(&line, &lineSize, fp) != -1) {
+        if (strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        if (batch.count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            batch.queries = realloc(batch.queries, capacity * sizeof(modQuery));
+            if (batch.queries == NULL) {
+                memoryError();
+            }
+        }
+        char *copy = strdup(line);
+        if (copy == NULL) {
+            memoryError();
+        }
+        if (!parseQuery(line, &batch.queries[batch.count])) {
+            fprintf(stderr, "Bad query: %s", copy);
+            badQueries++;
+        }
+        batch.count++;
+        free(copy);
+    }
+    free(line);
+    cacheGrow(&batch.cache);
+
+    pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+    if (threads == NULL) {
+        memoryError();
+    }
+    int started = 0;
+    for (; started < numThreads - 1; started++) {
+        if (pthread_create(&threads[started], NULL, modWorker, &batch) != 0) {
+            break;
+        }
+    }
+    modWorker(&batch);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    for (size_t i = 0; i < batch.count; i++) {
+        if (batch.queries[i].n == NULL) {
+            printf("error\n");
+        } else {
+            printf("%llu\n", (unsigned long long)batch.queries[i].result);
+        }
+        free(batch.queries[i].n);
+    }
+    free(batch.queries);
+    free(batch.cache.keys);
+    free(batch.cache.periods);
+    return badQueries > 0;
+}
+
+void usage()
+{
+    fprintf(stderr, "Usage: ./fibonacciCalculator [-b [file] | -n index | -f | -m [-j threads] [file]]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "-n") == 0 && argc == 3) {
+        uint64_t n;
+        if (!parseNumber(argv[2], &n)) {
+            fprintf(stderr, "ERROR: %s is not a number\n", argv[2]);
+            return 1;
+        }
+        bigNum fib = bigFib(n);
+        bigPrint(fib);
+        printf("\n");
+        bigFree(&fib);
+        return 0;
+    }
+    if (argc == 2 && strcmp(argv[1], "-f") == 0) {
+        bigNum n;
+        if (!bigRead(stdin, &n)) {
+            fprintf(stderr, "ERROR: expected a decimal number\n");
+            return 1;
+        }
+        bigPrint(n);
+        printf(bigIsFib(n) ? " is fib\n" : " is not fib\n");
+        bigFree(&n);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "-m") == 0) {
+        int numThreads = 1, i = 2;
+        if (argc > 3 && strcmp(argv[2], "-j") == 0) {
+            numThreads = atoi(argv[3]);
+            i = 4;
+        }
+        if (numThreads < 1 || argc > i + 1) {
+            usage();
+        }
+        FILE *fp = argc == i + 1 ? fopen(argv[i], "r") : stdin;
+        if (fp == NULL) {
+            fprintf(stderr, "ERROR: Cannot open %s\n", argv[i]);
+            return 1;
+        }
+        return fibModAll(fp, numThreads);
+    }
+    if (argc > 1) {
+        if (strcmp(argv[1], "-b") != 0 || argc > 3) {
+            usage();
+        }
+        FILE *fp = argc == 3 ? fopen(argv[2], "r") : stdin;
+        if (fp == NULL) {
+            fprintf(stderr, "ERROR: Cannot open %s\n", argv[2]);
+            return 1;
+        }
+        return classifyAll(fp);
+    }
+
+    char token[32];
+    int tooLong;
+    uint64_t userInput;
+    if (readToken(stdin, token, sizeof token, &tooLong) && !tooLong &&
+        parseNumber(token, &userInput) && userInput > 0) {
+        printf("%llu is", (unsigned long long)userInput);
+        if (isFib(userInput) == 1) {
+            printf(" fib");
+        }
+        if (isFib(userInput) == 0) {
+            printf(" not fib");
+        }
+    }
+    return 0;
+}
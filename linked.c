@@ -1,9 +1,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
 
 #define BUFFER_MAX_LEN 64
 
+/* reachability engines selectable with the @engine directive */
+#define ENGINE_DFS 0
+#define ENGINE_PARALLEL 1
+#define ENGINE_INCREMENTAL 2
+
+/* direction-optimizing BFS tuning: switch to bottom-up when the frontier
+   holds more than 1/ALPHA of the unexplored edges, and back to top-down
+   when it shrinks below 1/BETA of the pages */
+#define BFS_ALPHA 14
+#define BFS_BETA 24
+
+/* minimum number of pages per BFS thread; smaller graphs stay serial */
+#define BFS_GRAIN 16384
+
+/* memory allowed for the rows of the incremental engine. A row has a bit
+   per page, so a graph of n pages in n components needs n*n/8 bytes; past
+   this limit the engine is refused, or dropped in favour of dfs */
+#define CLOSURE_MAX_MB 1024
+
 struct link;
 
 struct page
@@ -11,6 +39,7 @@ struct page
     char value[BUFFER_MAX_LEN];
     int visited;
     int numLinks;
+    int id;
     struct link *links;
 };
 
@@ -20,10 +49,98 @@ struct link
     struct link * next;
 };
   
+/* compressed sparse row snapshot of the links, indexed by page id.
+   offsets/targets hold the outgoing links, inOffsets/inSources the
+   incoming ones (needed by the bottom-up BFS step). A snapshot loaded
+   from a checkpoint is mapped: its arrays live in the file mapping. */
+struct csr
+{
+  int numVertices;
+  long numEdges;
+  long *offsets;
+  int *targets;
+  long *inOffsets;
+  int *inSources;
+  int mapped;
+};
+
+/* memoized reachability answers keyed by (from, to) page ids.
+   Adding links only ever creates paths, so positive answers stay valid;
+   the targets of new links are queued in pendingTargets and negative
+   answers that may have changed are dropped before the next lookup.
+   That walk is linear in the pages it reaches, so the cache pays off for
+   repeated queries between rare link batches and is off until @cacheSize
+   turns it on. */
+struct reachEntry
+{
+  int from;
+  int to;
+  int answer;
+};
+
+struct reachCache
+{
+  struct reachEntry *slots;
+  int capacity;
+  int count;
+  int numNegative;
+  int maxEntries;
+  int *pendingTargets;
+  int numPending;
+  int pendingCapacity;
+  long hits;
+  long misses;
+  long invalidated;
+  long evicted;
+};
+
+/* transitive closure maintained under link insertion. Pages in one strongly
+   connected component share a union-find representative; each
+   representative owns a row with one bit per page, set for the
+   representatives of every component it reaches, and a list of the
+   components with a link into it, so an insert only walks back over the
+   components that reach the new link. */
+struct predList
+{
+  int *ids;        // pages whose representative links in, may repeat
+  int count;
+  int capacity;
+};
+
+struct closure
+{
+  int numVertices;
+  int capacity;
+  int words;
+  int *parent;
+  uint64_t **rows;
+  int *reps;
+  int *repPos;
+  int numReps;
+  struct predList *preds;
+  int *mark;       // == stamp once the current walk has queued the rep
+  int *queue;
+  int stamp;
+};
+
 struct graph
 {
   int numVertices;
   struct page** adjList;  
+  int *nameSlots;
+  int nameCapacity;
+  long numEdges;
+  int engine;
+  int csrDirty;
+  struct csr *csr;
+  struct reachCache cache;
+  struct closure *closure;
+  struct page *pageBlock;    // pages and links of a loaded checkpoint,
+  int numBlockPages;         // allocated in one block each
+  struct link *linkBlock;
+  long numBlockLinks;
+  void *mapping;             // the checkpoint file itself
+  size_t mappingSize;
 };
 
 struct page* createPage(char val[BUFFER_MAX_LEN])
@@ -36,6 +153,588 @@ struct page* createPage(char val[BUFFER_MAX_LEN])
   return newPage;  
 }
 
+/** FNV-1a hash of a page name */
+static unsigned long hashName(const char *name)
+{
+    unsigned long h = 2166136261UL;
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619UL;
+    return h;
+}
+
+/** returns the id of the page with the given name, -1 if there is none */
+int findPage(struct graph* aGraph, const char *name)
+{
+    if (aGraph->nameCapacity == 0)
+        return -1;
+    unsigned long mask = aGraph->nameCapacity - 1;
+    unsigned long slot = hashName(name) & mask;
+    while (aGraph->nameSlots[slot] != -1)
+    {
+        int id = aGraph->nameSlots[slot];
+        if (strcmp(aGraph->adjList[id]->value, name) == 0)
+            return id;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+/** adds a page to the name index (open addressing, kept at most half full).
+    If the name is already taken the first page keeps it. */
+static void indexPage(struct graph* aGraph, int id)
+{
+    if (2 * (aGraph->numVertices + 1) > aGraph->nameCapacity)
+    {
+        int capacity = aGraph->nameCapacity ? 2 * aGraph->nameCapacity : 1024;
+        free(aGraph->nameSlots);
+        aGraph->nameSlots = malloc(capacity * sizeof(int));
+        aGraph->nameCapacity = capacity;
+        memset(aGraph->nameSlots, -1, capacity * sizeof(int));
+        for (int i = 0; i < aGraph->numVertices; i++)
+            if (i != id)
+                indexPage(aGraph, i);
+    }
+    if (findPage(aGraph, aGraph->adjList[id]->value) != -1)
+        return;
+    unsigned long mask = aGraph->nameCapacity - 1;
+    unsigned long slot = hashName(aGraph->adjList[id]->value) & mask;
+    while (aGraph->nameSlots[slot] != -1)
+        slot = (slot + 1) & mask;
+    aGraph->nameSlots[slot] = id;
+}
+
+/** slot of (from, to) in the cache table: either its entry or the empty
+    slot where it belongs */
+static int cacheSlot(struct reachCache *cache, int from, int to)
+{
+    unsigned long mask = cache->capacity - 1;
+    unsigned long slot = (((unsigned long)from * 0x9E3779B97F4A7C15UL) ^ (unsigned long)to) * 0xBF58476D1CE4E5B9UL;
+    slot = (slot >> 17) & mask;
+    while (cache->slots[slot].from != -1 &&
+           (cache->slots[slot].from != from || cache->slots[slot].to != to))
+        slot = (slot + 1) & mask;
+    return (int)slot;
+}
+
+/** empties the table and resizes it to hold the given number of entries */
+static void cacheReset(struct reachCache *cache, int capacity)
+{
+    free(cache->slots);
+    cache->slots = malloc(capacity * sizeof(struct reachEntry));
+    cache->capacity = cache->slots != NULL ? capacity : 0;
+    cache->count = 0;
+    cache->numNegative = 0;
+    for (int i = 0; i < cache->capacity; i++)
+        cache->slots[i].from = -1;
+}
+
+static void cacheInsert(struct reachCache *cache, int from, int to, int answer)
+{
+    int slot = cacheSlot(cache, from, to);
+    if (cache->slots[slot].from == -1)
+    {
+        cache->count++;
+        if (!answer)
+            cache->numNegative++;
+    }
+    cache->slots[slot].from = from;
+    cache->slots[slot].to = to;
+    cache->slots[slot].answer = answer;
+}
+
+/** remembers that the given page just got a new incoming link */
+static void cacheNoteLink(struct reachCache *cache, int target)
+{
+    if (cache->numNegative == 0)
+        return;
+    if (cache->numPending == cache->pendingCapacity)
+    {
+        cache->pendingCapacity = cache->pendingCapacity ? 2 * cache->pendingCapacity : 64;
+        cache->pendingTargets = realloc(cache->pendingTargets,
+                                        cache->pendingCapacity * sizeof(int));
+    }
+    cache->pendingTargets[cache->numPending++] = target;
+}
+
+/** drops the negative answers that links added since the last call may
+    have turned positive: a new link u->v can only create a path a->b if
+    b is reachable from v, so one walk from all queued targets finds every
+    page b whose negative entries are suspect */
+static void cacheInvalidate(struct graph* aGraph)
+{
+    struct reachCache *cache = &aGraph->cache;
+    if (cache->numPending == 0)
+        return;
+
+    int n = aGraph->numVertices;
+    char *marked = calloc(n, 1);
+    int *stack = malloc(n * sizeof(int));
+    int top = 0, i;
+    if (marked == NULL || stack == NULL)
+    {
+        // cannot tell which entries changed: forget all of them
+        free(marked);
+        free(stack);
+        cache->invalidated += cache->count;
+        cacheReset(cache, cache->capacity);
+        cache->numPending = 0;
+        return;
+    }
+    for (i = 0; i < cache->numPending; i++)
+    {
+        int v = cache->pendingTargets[i];
+        if (!marked[v])
+        {
+            marked[v] = 1;
+            stack[top++] = v;
+        }
+    }
+    while (top > 0)
+    {
+        struct link *current;
+        for (current = aGraph->adjList[stack[--top]]->links; current != NULL; current = current->next)
+        {
+            int w = current->toPage->id;
+            if (!marked[w])
+            {
+                marked[w] = 1;
+                stack[top++] = w;
+            }
+        }
+    }
+    cache->numPending = 0;
+
+    // rehash the surviving entries
+    int capacity = cache->capacity;
+    struct reachEntry *old = cache->slots;
+    cache->slots = NULL;
+    cacheReset(cache, capacity);
+    for (i = 0; i < capacity; i++)
+    {
+        if (old[i].from == -1)
+            continue;
+        if (!old[i].answer && marked[old[i].to])
+            cache->invalidated++;
+        else
+            cacheInsert(cache, old[i].from, old[i].to, old[i].answer);
+    }
+    free(old);
+    free(marked);
+    free(stack);
+}
+
+/** looks up a memoized answer: 1 or 0, or -1 if the pair is not cached */
+int cacheLookup(struct graph* aGraph, int from, int to)
+{
+    struct reachCache *cache = &aGraph->cache;
+    if (cache->maxEntries == 0)
+        return -1;
+    cacheInvalidate(aGraph);
+    if (cache->capacity > 0)
+    {
+        int slot = cacheSlot(cache, from, to);
+        if (cache->slots[slot].from != -1)
+        {
+            cache->hits++;
+            return cache->slots[slot].answer;
+        }
+    }
+    cache->misses++;
+    return -1;
+}
+
+/** memoizes an answer. When the cache reaches its limit it starts over. */
+void cacheStore(struct graph* aGraph, int from, int to, int answer)
+{
+    struct reachCache *cache = &aGraph->cache;
+    if (cache->maxEntries == 0)
+        return;
+    if (cache->count >= cache->maxEntries)
+    {
+        cache->evicted += cache->count;
+        cacheReset(cache, cache->capacity);
+    }
+    if (2 * (cache->count + 1) > cache->capacity)
+    {
+        int capacity = cache->capacity ? 2 * cache->capacity : 1024;
+        struct reachEntry *old = cache->slots;
+        int oldCapacity = cache->capacity;
+        cache->slots = NULL;
+        cacheReset(cache, capacity);
+        if (cache->capacity == 0)
+        {
+            free(old);
+            return;
+        }
+        for (int i = 0; i < oldCapacity; i++)
+            if (old[i].from != -1)
+                cacheInsert(cache, old[i].from, old[i].to, old[i].answer);
+        free(old);
+    }
+    cacheInsert(cache, from, to, answer);
+}
+
+/* ---------------- incremental reachability (SCC closure) ---------------- */
+
+struct csr* currentCsr(struct graph* aGraph);
+
+static int closureFind(struct closure *c, int v)
+{
+    while (c->parent[v] != v)
+    {
+        c->parent[v] = c->parent[c->parent[v]];
+        v = c->parent[v];
+    }
+    return v;
+}
+
+static int rowBit(const uint64_t *row, int v)
+{
+    return (row[v >> 6] >> (v & 63)) & 1;
+}
+
+static void closureAddRep(struct closure *c, int v)
+{
+    c->repPos[v] = c->numReps;
+    c->reps[c->numReps++] = v;
+}
+
+static void closureRemoveRep(struct closure *c, int v)
+{
+    int last = c->reps[--c->numReps];
+    c->reps[c->repPos[v]] = last;
+    c->repPos[last] = c->repPos[v];
+    c->repPos[v] = -1;
+}
+
+void freeClosure(struct closure *c)
+{
+    if (c == NULL)
+        return;
+    for (int i = 0; i < c->numReps; i++)
+        free(c->rows[c->reps[i]]);
+    if (c->preds != NULL)
+        for (int i = 0; i < c->capacity; i++)
+            free(c->preds[i].ids);
+    free(c->rows);
+    free(c->parent);
+    free(c->reps);
+    free(c->repPos);
+    free(c->preds);
+    free(c->mark);
+    free(c->queue);
+    free(c);
+}
+
+/** true if numReps rows of the given width stay within CLOSURE_MAX_MB */
+static int closureFits(int64_t numReps, int64_t words)
+{
+    return numReps * words * (int64_t)sizeof(uint64_t) <= (int64_t)CLOSURE_MAX_MB << 20;
+}
+
+/** notes that page from links into the component of rep.
+    returns -1 if out of memory */
+static int closureAddPred(struct closure *c, int rep, int from)
+{
+    struct predList *p = &c->preds[rep];
+    if (p->count == p->capacity)
+    {
+        int capacity = p->capacity ? 2 * p->capacity : 4;
+        int *ids = realloc(p->ids, capacity * sizeof(int));
+        if (ids == NULL)
+            return -1;
+        p->ids = ids;
+        p->capacity = capacity;
+    }
+    p->ids[p->count++] = from;
+    return 0;
+}
+
+/** widens the closure so it can hold pages 0..numPages-1, doubling the bit
+    capacity of every row when it runs out. returns -1 if out of memory or
+    if the rows would outgrow CLOSURE_MAX_MB */
+static int closureReserve(struct closure *c, int numPages)
+{
+    if (numPages <= c->capacity)
+        return 0;
+    int capacity = c->capacity ? 2 * c->capacity : 1024;
+    while (capacity < numPages)
+        capacity *= 2;
+    int words = capacity / 64;
+    if (!closureFits(c->numReps, words))
+        return -1;
+    int *parent = realloc(c->parent, capacity * sizeof(int));
+    if (parent != NULL)
+        c->parent = parent;
+    int *reps = realloc(c->reps, capacity * sizeof(int));
+    if (reps != NULL)
+        c->reps = reps;
+    int *repPos = realloc(c->repPos, capacity * sizeof(int));
+    if (repPos != NULL)
+        c->repPos = repPos;
+    uint64_t **rows = realloc(c->rows, capacity * sizeof(uint64_t *));
+    if (rows != NULL)
+        c->rows = rows;
+    struct predList *preds = realloc(c->preds, capacity * sizeof(struct predList));
+    if (preds != NULL)
+    {
+        memset(preds + c->capacity, 0, (capacity - c->capacity) * sizeof(struct predList));
+        c->preds = preds;
+    }
+    int *mark = realloc(c->mark, capacity * sizeof(int));
+    if (mark != NULL)
+    {
+        memset(mark + c->capacity, 0, (capacity - c->capacity) * sizeof(int));
+        c->mark = mark;
+    }
+    int *queue = realloc(c->queue, capacity * sizeof(int));
+    if (queue != NULL)
+        c->queue = queue;
+    if (parent == NULL || reps == NULL || repPos == NULL || rows == NULL ||
+        preds == NULL || mark == NULL || queue == NULL)
+        return -1;
+    for (int i = 0; i < c->numReps; i++)
+    {
+        int x = c->reps[i];
+        uint64_t *row = realloc(c->rows[x], words * sizeof(uint64_t));
+        if (row == NULL)
+            return -1;
+        memset(row + c->words, 0, (words - c->words) * sizeof(uint64_t));
+        c->rows[x] = row;
+    }
+    c->capacity = capacity;
+    c->words = words;
+    return 0;
+}
+
+/** gives the new page v a component of its own. returns -1 if out of memory
+    or over CLOSURE_MAX_MB */
+int closureAddPage(struct closure *c, int v)
+{
+    if (closureReserve(c, v + 1) == -1 || !closureFits(c->numReps + 1, c->words))
+        return -1;
+    c->rows[v] = calloc(c->words, sizeof(uint64_t));
+    if (c->rows[v] == NULL)
+        return -1;
+    c->rows[v][v >> 6] |= (uint64_t)1 << (v & 63);
+    c->parent[v] = v;
+    closureAddRep(c, v);
+    c->numVertices = v + 1;
+    return 0;
+}
+
+/** updates the closure for a new link u->v. The walk goes back from u's
+    component over the links into it and gives v's row to every component
+    it meets; one that already reaches v ends the walk there, since all
+    that reach it reach v too. If the link closes a cycle, the components
+    on it are all on the walk and are merged into u's component.
+    returns -1 if out of memory */
+int closureInsert(struct closure *c, int u, int v)
+{
+    int cu = closureFind(c, u), cv = closureFind(c, v);
+    if (cu == cv || rowBit(c->rows[cu], cv))
+        return 0;
+    if (closureAddPred(c, cv, cu) == -1)
+        return -1;
+    if (c->stamp == INT32_MAX)
+    {
+        memset(c->mark, 0, c->capacity * sizeof(int));
+        c->stamp = 0;
+    }
+    int stamp = ++c->stamp;
+
+    const uint64_t *add = c->rows[cv];
+    int head = 0, tail = 0, i, w;
+    c->queue[tail++] = cu;
+    c->mark[cu] = stamp;
+    while (head < tail)
+    {
+        int x = c->queue[head++];
+        uint64_t *row = c->rows[x];
+        if (rowBit(row, cv))
+            continue;
+        for (w = 0; w < c->words; w++)
+            row[w] |= add[w];
+        const struct predList *p = &c->preds[x];
+        for (i = 0; i < p->count; i++)
+        {
+            int y = closureFind(c, p->ids[i]);
+            if (c->mark[y] != stamp)
+            {
+                c->mark[y] = stamp;
+                c->queue[tail++] = y;
+            }
+        }
+    }
+
+    if (!rowBit(c->rows[cv], cu))
+        return 0;
+    // cycle: every component on the walk that v reaches joins cu. None of
+    // them reached v before, so the walk went through all of them. Collect
+    // them first, cv's own row is needed until the last test.
+    int numMerged = 0;
+    for (i = 1; i < tail; i++)
+        if (rowBit(c->rows[cv], c->queue[i]))
+            c->queue[numMerged++] = c->queue[i];
+    for (i = 0; i < numMerged; i++)
+    {
+        int y = c->queue[i];
+        c->parent[y] = cu;
+        free(c->rows[y]);
+        c->rows[y] = NULL;
+        closureRemoveRep(c, y);
+    }
+    // the links into merged components now lead into cu
+    int failed = 0;
+    for (i = 0; i < numMerged; i++)
+    {
+        struct predList *p = &c->preds[c->queue[i]];
+        for (int k = 0; k < p->count && !failed; k++)
+            if (closureFind(c, p->ids[k]) != cu)
+                failed = closureAddPred(c, cu, p->ids[k]) == -1;
+        free(p->ids);
+        p->ids = NULL;
+        p->count = p->capacity = 0;
+    }
+    return failed ? -1 : 0;
+}
+
+int closureQuery(struct closure *c, int from, int to)
+{
+    int cf = closureFind(c, from), ct = closureFind(c, to);
+    return cf == ct || rowBit(c->rows[cf], ct);
+}
+
+/** builds the closure of the current graph: iterative Tarjan emits the
+    SCCs sinks first, so each component's row is the union of the rows of
+    the components it links to. returns NULL if out of memory */
+struct closure* buildClosure(struct graph* aGraph)
+{
+    struct csr *g = currentCsr(aGraph);
+    struct closure *c = calloc(1, sizeof(struct closure));
+    if (g == NULL || c == NULL)
+    {
+        free(c);
+        return NULL;
+    }
+    int n = g->numVertices;
+    if (closureReserve(c, n) == -1)
+    {
+        freeClosure(c);
+        return NULL;
+    }
+    c->numVertices = n;
+
+    int *index = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *low = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *stack = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *callStack = malloc((n > 0 ? n : 1) * sizeof(int));
+    long *nextEdge = malloc((n > 0 ? n : 1) * sizeof(long));
+    char *onStack = calloc(n > 0 ? n : 1, 1);
+    if (index == NULL || low == NULL || stack == NULL || callStack == NULL ||
+        nextEdge == NULL || onStack == NULL)
+    {
+        free(index); free(low); free(stack);
+        free(callStack); free(nextEdge); free(onStack);
+        freeClosure(c);
+        return NULL;
+    }
+    memset(index, -1, n * sizeof(int));
+
+    int counter = 0, top = 0, depth = 0, root, failed = 0;
+    for (root = 0; root < n && !failed; root++)
+    {
+        if (index[root] != -1)
+            continue;
+        callStack[depth++] = root;
+        index[root] = low[root] = counter++;
+        nextEdge[root] = g->offsets[root];
+        stack[top++] = root;
+        onStack[root] = 1;
+
+        while (depth > 0 && !failed)
+        {
+            int v = callStack[depth-1];
+            if (nextEdge[v] < g->offsets[v+1])
+            {
+                int w = g->targets[nextEdge[v]++];
+                if (index[w] == -1)
+                {
+                    index[w] = low[w] = counter++;
+                    nextEdge[w] = g->offsets[w];
+                    stack[top++] = w;
+                    onStack[w] = 1;
+                    callStack[depth++] = w;
+                }
+                else if (onStack[w] && index[w] < low[v])
+                    low[v] = index[w];
+                continue;
+            }
+
+            depth--;
+            if (depth > 0 && low[v] < low[callStack[depth-1]])
+                low[callStack[depth-1]] = low[v];
+            if (low[v] != index[v])
+                continue;
+
+            // v roots an SCC: members are on the stack down to v
+            uint64_t *row = closureFits(c->numReps + 1, c->words) ?
+                            calloc(c->words, sizeof(uint64_t)) : NULL;
+            if (row == NULL)
+            {
+                failed = 1;
+                break;
+            }
+            int first = top, x;
+            do
+            {
+                x = stack[--first];
+                onStack[x] = 0;
+                c->parent[x] = v;
+                row[x >> 6] |= (uint64_t)1 << (x & 63);
+            } while (x != v);
+            c->rows[v] = row;
+            closureAddRep(c, v);
+            for (int k = first; k < top; k++)
+            {
+                long e;
+                for (e = g->offsets[stack[k]]; e < g->offsets[stack[k]+1]; e++)
+                {
+                    // a component already in the row brought its whole row
+                    int cw = closureFind(c, g->targets[e]);
+                    if (cw == v || rowBit(row, cw))
+                        continue;
+                    for (int wd = 0; wd < c->words; wd++)
+                        row[wd] |= c->rows[cw][wd];
+                    if (closureAddPred(c, cw, v) == -1)
+                        failed = 1;
+                }
+            }
+            top = first;
+        }
+    }
+
+    free(index); free(low); free(stack);
+    free(callStack); free(nextEdge); free(onStack);
+    if (failed)
+    {
+        freeClosure(c);
+        return NULL;
+    }
+    return c;
+}
+
+/** the closure ran out of memory or over CLOSURE_MAX_MB: drop the index
+    and answer with dfs from now on */
+static void dropClosure(struct graph* aGraph)
+{
+    printf("Error. Not enough memory for the incremental engine (limit %d MB), using dfs\n",
+           CLOSURE_MAX_MB);
+    freeClosure(aGraph->closure);
+    aGraph->closure = NULL;
+    aGraph->engine = ENGINE_DFS;
+}
+
 /** inserts a page into the graph */
 void addPage(struct graph* aGraph, char val[BUFFER_MAX_LEN])
 {
@@ -44,24 +743,20 @@ void addPage(struct graph* aGraph, char val[BUFFER_MAX_LEN])
     	                (aGraph->numVertices) * sizeof(struct page*));
 
     aGraph->adjList[ aGraph->numVertices-1] = createPage(val);
+    aGraph->adjList[ aGraph->numVertices-1]->id = aGraph->numVertices-1;
+    indexPage(aGraph, aGraph->numVertices-1);
+    if (aGraph->closure != NULL &&
+        closureAddPage(aGraph->closure, aGraph->numVertices-1) == -1)
+        dropClosure(aGraph);
+    aGraph->csrDirty = 1;
 }
 
 /** inserts a link between the source page and target page. */
 void addLink(struct graph* aGraph, char source[BUFFER_MAX_LEN],
         char target[BUFFER_MAX_LEN], int *status)
 { 
-    size_t i = -1, sourcePos = -1, targetPos = -1;
-    for (i=0; i < aGraph->numVertices; i++)
-    {
-        if (strcmp(aGraph->adjList[i]->value, source) == 0)
-            sourcePos = i;
-        
-        if (strcmp(aGraph->adjList[i]->value, target) == 0)
-            targetPos = i;
-        
-        if (targetPos != -1 && sourcePos != -1)
-            break;
-    }
+    int sourcePos = findPage(aGraph, source);
+    int targetPos = findPage(aGraph, target);
     
     int tempStatus = *status;
     if (sourcePos == -1)
@@ -91,16 +786,22 @@ void addLink(struct graph* aGraph, char source[BUFFER_MAX_LEN],
     }
     else
     {
-
-        while (current->links->next != NULL)
+        struct link *last = current->links;
+        while (last->next != NULL)
         {
-            current->links = current->links->next;   
+            last = last->next;   
         }    
-        current->links->next = (struct link*)malloc(sizeof(struct link));
-        current->links->next->toPage = aGraph->adjList[targetPos];
-        current->links->next->next = NULL;
+        last->next = (struct link*)malloc(sizeof(struct link));
+        last->next->toPage = aGraph->adjList[targetPos];
+        last->next->next = NULL;
     }    
- 
+    current->numLinks++;
+    aGraph->numEdges++;
+    cacheNoteLink(&aGraph->cache, targetPos);
+    if (aGraph->closure != NULL &&
+        closureInsert(aGraph->closure, sourcePos, targetPos) == -1)
+        dropClosure(aGraph);
+    aGraph->csrDirty = 1;
 }
 
 void addPages(struct graph* aGraph, char line[BUFFER_MAX_LEN])
@@ -149,7 +850,7 @@ int dfs(struct page* fromPage, struct page* toPage) {
     
     if (fromPage->visited == 1)
     {
-        return 1;
+        return 0;
     }
     
     fromPage->visited = 1;
@@ -166,110 +867,1317 @@ int dfs(struct page* fromPage, struct page* toPage) {
     return 0;
 }
 
-int isConnected(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
-{    
-    int tempStatus = *status;
-    size_t pos = 0;
-    char toPage[BUFFER_MAX_LEN];
-    char fromPage[BUFFER_MAX_LEN];
-    
-    if (sscanf(line+pos, "%s", fromPage) == -1)
+void freeCsr(struct csr *aCsr)
+{
+    if (aCsr == NULL)
+        return;
+    if (aCsr->mapped)
     {
-        printf("Error. Source page is not specified directive\n");
-        tempStatus = 1;
-        status = &tempStatus;
-        return 0;
+        free(aCsr);
+        return;
     }
-    
-    pos += strlen(fromPage)+1;
-    
-    if (sscanf(line+pos, "%s", toPage) == -1)
-    {
-        printf("Error. Link page is not specified directive\n");
-        tempStatus = 1;
-        status = &tempStatus;
-        return 0;
-    }    
-    
-    size_t i, fromPos = -1, toPos = -1;
-    for (i=0; i < aGraph->numVertices; i++)
-    {
-        aGraph->adjList[i]->visited = 0;
-        
-        if (strcmp(aGraph->adjList[i]->value, fromPage) == 0)
-            fromPos = i;
+    free(aCsr->offsets);
+    free(aCsr->targets);
+    free(aCsr->inOffsets);
+    free(aCsr->inSources);
+    free(aCsr);
+}
 
-        if (strcmp(aGraph->adjList[i]->value, toPage) == 0)
-            toPos = i;
+/** flattens the link lists into a csr snapshot, returns NULL if out of memory */
+struct csr* buildCsr(struct graph* aGraph)
+{
+    int n = aGraph->numVertices;
+    long m = aGraph->numEdges;
+    struct csr *aCsr = calloc(1, sizeof(struct csr));
+    if (aCsr == NULL)
+        return NULL;
+    aCsr->numVertices = n;
+    aCsr->numEdges = m;
+    aCsr->offsets = malloc((n+1) * sizeof(long));
+    aCsr->inOffsets = calloc(n+1, sizeof(long));
+    aCsr->targets = malloc((m > 0 ? m : 1) * sizeof(int));
+    aCsr->inSources = malloc((m > 0 ? m : 1) * sizeof(int));
+    if (aCsr->offsets == NULL || aCsr->inOffsets == NULL ||
+        aCsr->targets == NULL || aCsr->inSources == NULL)
+    {
+        freeCsr(aCsr);
+        return NULL;
     }
 
+    long pos = 0;
+    int i;
+    for (i=0; i < n; i++)
+    {
+        aCsr->offsets[i] = pos;
+        struct link *current;
+        for (current = aGraph->adjList[i]->links; current != NULL; current = current->next)
+        {
+            aCsr->targets[pos++] = current->toPage->id;
+            aCsr->inOffsets[current->toPage->id+1]++;
+        }
+    }
+    aCsr->offsets[n] = pos;
 
-    if (fromPos == -1)
+    // incoming links: prefix sums, then scatter
+    for (i=0; i < n; i++)
+        aCsr->inOffsets[i+1] += aCsr->inOffsets[i];
+    long *fill = malloc((n > 0 ? n : 1) * sizeof(long));
+    if (fill == NULL)
     {
-        tempStatus = 1;
-        status = &tempStatus;
-        printf("Error. Source page is not specified directive\n");
-        return 0;
-    } 
-    
-    if (toPos == -1)
+        freeCsr(aCsr);
+        return NULL;
+    }
+    memcpy(fill, aCsr->inOffsets, n * sizeof(long));
+    for (i=0; i < n; i++)
     {
-        tempStatus = 1;
-        status = &tempStatus;
-        printf("Error. Link page is not specified directive\n");
-        return 0;
-    }      
-        
-   return dfs(aGraph->adjList[fromPos], aGraph->adjList[toPos]);
+        long e;
+        for (e = aCsr->offsets[i]; e < aCsr->offsets[i+1]; e++)
+            aCsr->inSources[fill[aCsr->targets[e]]++] = i;
+    }
+    free(fill);
+    return aCsr;
 }
 
-void destroy(struct graph* aGraph)
+/** returns the csr snapshot, rebuilding it if pages or links were added since */
+struct csr* currentCsr(struct graph* aGraph)
 {
-	int i;
-	for (i=0; i < aGraph->numVertices; i++)
-	{
-		struct link *current = aGraph->adjList[i]->links;
+    if (aGraph->csr == NULL || aGraph->csrDirty)
+    {
+        freeCsr(aGraph->csr);
+        aGraph->csr = buildCsr(aGraph);
+        aGraph->csrDirty = 0;
+    }
+    return aGraph->csr;
+}
 
-		while (current != NULL)
-		{
-			struct link *temp = current;			
-			current = current->next;
-			free(temp);
-			temp=NULL;
-		}
-		if (aGraph->adjList[i] != NULL)
-		{
-			free(aGraph->adjList[i]);
-			aGraph->adjList[i] = NULL;
+/* ---------------- parallel direction-optimizing BFS ---------------- */
+
+/* state shared by all BFS threads. Each level runs between two barriers;
+   thread 0 then inspects the new frontier and picks the direction of the
+   next level. */
+struct bfsState
+{
+    const struct csr *g;
+    int target;
+    int numThreads;
+    _Atomic uint64_t *visited;
+    _Atomic uint64_t *frontBits;
+    _Atomic uint64_t *nextBits;
+    int *queue;
+    int *nextQueue;
+    long queueSize;
+    atomic_long nextSize;
+    atomic_long nextEdges;
+    long frontEdges;
+    long unexploredEdges;
+    int bottomUp;
+    int done;
+    atomic_int found;
+    pthread_barrier_t barrier;
+};
+
+struct bfsWorker
+{
+    struct bfsState *state;
+    int id;
+};
+
+#define BFS_LOCAL_QUEUE 1024
+
+static int testBit(_Atomic uint64_t *bits, int v)
+{
+    return (atomic_load_explicit(&bits[v >> 6], memory_order_relaxed) >> (v & 63)) & 1;
+}
+
+/** sets bit v, returns 1 if this call was the one that set it */
+static int claimBit(_Atomic uint64_t *bits, int v)
+{
+    uint64_t mask = (uint64_t)1 << (v & 63);
+    if (atomic_load_explicit(&bits[v >> 6], memory_order_relaxed) & mask)
+        return 0;
+    return !(atomic_fetch_or_explicit(&bits[v >> 6], mask, memory_order_relaxed) & mask);
+}
+
+static void flushLocalQueue(struct bfsState *s, int *local, int count)
+{
+    long at = atomic_fetch_add_explicit(&s->nextSize, count, memory_order_relaxed);
+    memcpy(s->nextQueue + at, local, count * sizeof(int));
+}
+
+/** top-down step: this thread expands its slice of the frontier queue */
+static void topDownStep(struct bfsState *s, int id)
+{
+    const struct csr *g = s->g;
+    long lo = s->queueSize * id / s->numThreads;
+    long hi = s->queueSize * (id+1) / s->numThreads;
+    int local[BFS_LOCAL_QUEUE];
+    int count = 0;
+    long edges = 0;
+    long i, e;
+
+    for (i = lo; i < hi && !atomic_load_explicit(&s->found, memory_order_relaxed); i++)
+    {
+        int u = s->queue[i];
+        for (e = g->offsets[u]; e < g->offsets[u+1]; e++)
+        {
+            int v = g->targets[e];
+            if (!claimBit(s->visited, v))
+                continue;
+            if (v == s->target)
+                atomic_store_explicit(&s->found, 1, memory_order_relaxed);
+            edges += g->offsets[v+1] - g->offsets[v];
+            local[count++] = v;
+            if (count == BFS_LOCAL_QUEUE)
+            {
+                flushLocalQueue(s, local, count);
+                count = 0;
+            }
+        }
+    }
+    if (count > 0)
+        flushLocalQueue(s, local, count);
+    atomic_fetch_add_explicit(&s->nextEdges, edges, memory_order_relaxed);
+}
+
+/** bottom-up step: every unvisited page in this thread's range looks for
+    a parent in the frontier bitmap. Ranges are word aligned. */
+static void bottomUpStep(struct bfsState *s, int id)
+{
+    const struct csr *g = s->g;
+    long numWords = (g->numVertices + 63) / 64;
+    long wlo = numWords * id / s->numThreads;
+    long whi = numWords * (id+1) / s->numThreads;
+    long count = 0, edges = 0;
+    long w, e;
+
+    for (w = wlo; w < whi && !atomic_load_explicit(&s->found, memory_order_relaxed); w++)
+    {
+        uint64_t unvisited = ~atomic_load_explicit(&s->visited[w], memory_order_relaxed);
+        while (unvisited != 0)
+        {
+            int v = (int)(w * 64 + __builtin_ctzll(unvisited));
+            unvisited &= unvisited - 1;
+            if (v >= g->numVertices)
+                break;
+            for (e = g->inOffsets[v]; e < g->inOffsets[v+1]; e++)
+            {
+                if (testBit(s->frontBits, g->inSources[e]))
+                {
+                    claimBit(s->visited, v);
+                    claimBit(s->nextBits, v);
+                    if (v == s->target)
+                        atomic_store_explicit(&s->found, 1, memory_order_relaxed);
+                    count++;
+                    edges += g->offsets[v+1] - g->offsets[v];
+                    break;
+                }
+            }
+        }
+    }
+    atomic_fetch_add_explicit(&s->nextSize, count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->nextEdges, edges, memory_order_relaxed);
+}
+
+/** run by thread 0 between levels: decides the direction of the next level
+    and converts the frontier between queue and bitmap form if needed */
+static void advanceLevel(struct bfsState *s)
+{
+    const struct csr *g = s->g;
+    long numWords = (g->numVertices + 63) / 64;
+    long size = atomic_load(&s->nextSize);
+    long w;
+
+    s->unexploredEdges -= s->frontEdges;
+    s->frontEdges = atomic_load(&s->nextEdges);
+    atomic_store(&s->nextSize, 0);
+    atomic_store(&s->nextEdges, 0);
+
+    if (atomic_load(&s->found) || size == 0)
+    {
+        s->done = 1;
+        return;
+    }
+
+    if (!s->bottomUp)
+    {
+        int *tmp = s->queue;
+        s->queue = s->nextQueue;
+        s->nextQueue = tmp;
+        s->queueSize = size;
+        if (s->frontEdges > s->unexploredEdges / BFS_ALPHA)
+        {
+            long i;
+            s->bottomUp = 1;
+            memset((void *)s->frontBits, 0, numWords * sizeof(uint64_t));
+            memset((void *)s->nextBits, 0, numWords * sizeof(uint64_t));
+            for (i = 0; i < size; i++)
+                claimBit(s->frontBits, s->queue[i]);
+        }
+    }
+    else
+    {
+        _Atomic uint64_t *tmp = s->frontBits;
+        s->frontBits = s->nextBits;
+        s->nextBits = tmp;
+        memset((void *)s->nextBits, 0, numWords * sizeof(uint64_t));
+        if (size < g->numVertices / BFS_BETA)
+        {
+            s->bottomUp = 0;
+            s->queueSize = 0;
+            for (w = 0; w < numWords; w++)
+            {
+                uint64_t bits = atomic_load_explicit(&s->frontBits[w], memory_order_relaxed);
+                while (bits != 0)
+                {
+                    s->queue[s->queueSize++] = (int)(w * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+}
+
+static void *bfsWorkerRun(void *arg)
+{
+    struct bfsWorker *worker = arg;
+    struct bfsState *s = worker->state;
+    while (1)
+    {
+        pthread_barrier_wait(&s->barrier);
+        if (s->done)
+            break;
+        if (s->bottomUp)
+            bottomUpStep(s, worker->id);
+        else
+            topDownStep(s, worker->id);
+        pthread_barrier_wait(&s->barrier);
+        if (worker->id == 0)
+            advanceLevel(s);
+    }
+    return NULL;
+}
+
+/** number of BFS threads for a graph: all online cores, but at least
+    BFS_GRAIN pages per thread */
+static int bfsThreads(const struct csr *g)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    long byGrain = g->numVertices / BFS_GRAIN;
+    if (cores < 1)
+        cores = 1;
+    if (byGrain < 1)
+        byGrain = 1;
+    return (int)(cores < byGrain ? cores : byGrain);
+}
+
+/* bfsReach(g, source, target, visited) -- level-synchronous BFS from
+    source that switches between top-down and bottom-up expansion.
+    visited must be a zeroed bitmap of (numVertices+63)/64 words; on return
+    it holds every page discovered. Stops as soon as target is discovered;
+    pass target = -1 to explore everything reachable.
+    returns 1 if target was reached, 0 if not, -1 if out of memory */
+int bfsReach(const struct csr *g, int source, int target, _Atomic uint64_t *visited)
+{
+    long numWords = (g->numVertices + 63) / 64;
+    struct bfsState s;
+    memset(&s, 0, sizeof s);
+    s.g = g;
+    s.target = target;
+    s.numThreads = bfsThreads(g);
+    s.visited = visited;
+    s.queue = malloc(g->numVertices * sizeof(int));
+    s.nextQueue = malloc(g->numVertices * sizeof(int));
+    s.frontBits = calloc(numWords, sizeof(uint64_t));
+    s.nextBits = calloc(numWords, sizeof(uint64_t));
+    if (s.queue == NULL || s.nextQueue == NULL || s.frontBits == NULL || s.nextBits == NULL)
+    {
+        free(s.queue);
+        free(s.nextQueue);
+        free((void *)s.frontBits);
+        free((void *)s.nextBits);
+        return -1;
+    }
+
+    claimBit(visited, source);
+    s.queue[0] = source;
+    s.queueSize = 1;
+    s.frontEdges = g->offsets[source+1] - g->offsets[source];
+    s.unexploredEdges = g->numEdges;
+    atomic_init(&s.nextSize, 0);
+    atomic_init(&s.nextEdges, 0);
+    atomic_init(&s.found, source == target);
+    s.done = (source == target);
+
+    pthread_t threads[s.numThreads];
+    struct bfsWorker workers[s.numThreads];
+    pthread_barrier_init(&s.barrier, NULL, s.numThreads);
+    for (int i = 0; i < s.numThreads; i++)
+    {
+        workers[i].state = &s;
+        workers[i].id = i;
+        if (i > 0 && pthread_create(&threads[i], NULL, bfsWorkerRun, &workers[i]) != 0)
+        {
+            fprintf(stderr, "Fatal error: cannot start BFS thread.\n");
+            exit(1);
+        }
+    }
+    bfsWorkerRun(&workers[0]);
+    for (int i = 1; i < s.numThreads; i++)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&s.barrier);
+
+    free(s.queue);
+    free(s.nextQueue);
+    free((void *)s.frontBits);
+    free((void *)s.nextBits);
+    return atomic_load(&s.found);
+}
+
+/** answers whether toPos is reachable from fromPos with the selected engine */
+int reachable(struct graph* aGraph, int fromPos, int toPos)
+{
+    if (aGraph->engine == ENGINE_INCREMENTAL)
+        return closureQuery(aGraph->closure, fromPos, toPos);
+
+    if (aGraph->engine == ENGINE_PARALLEL)
+    {
+        struct csr *aCsr = currentCsr(aGraph);
+        _Atomic uint64_t *visited = calloc((aGraph->numVertices + 63) / 64, sizeof(uint64_t));
+        int reached = -1;
+        if (aCsr != NULL && visited != NULL)
+            reached = bfsReach(aCsr, fromPos, toPos, visited);
+        free((void *)visited);
+        if (reached != -1)
+            return reached;
+        // out of memory for the parallel engine: fall back to dfs
+    }
+
+    int i;
+    for (i=0; i < aGraph->numVertices; i++)
+        aGraph->adjList[i]->visited = 0;
+
+    return dfs(aGraph->adjList[fromPos], aGraph->adjList[toPos]);
+}
+
+int isConnected(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
+{    
+    int tempStatus = *status;
+    size_t pos = 0;
+    char toPage[BUFFER_MAX_LEN];
+    char fromPage[BUFFER_MAX_LEN];
+    
+    if (sscanf(line+pos, "%s", fromPage) == -1)
+    {
+        printf("Error. Source page is not specified directive\n");
+        tempStatus = 1;
+        status = &tempStatus;
+        return 0;
+    }
+    
+    pos += strlen(fromPage)+1;
+    
+    if (sscanf(line+pos, "%s", toPage) == -1)
+    {
+        printf("Error. Link page is not specified directive\n");
+        tempStatus = 1;
+        status = &tempStatus;
+        return 0;
+    }    
+    
+    int fromPos = findPage(aGraph, fromPage);
+    int toPos = findPage(aGraph, toPage);
+
+
+    if (fromPos == -1)
+    {
+        tempStatus = 1;
+        status = &tempStatus;
+        printf("Error. Source page is not specified directive\n");
+        return 0;
+    } 
+    
+    if (toPos == -1)
+    {
+        tempStatus = 1;
+        status = &tempStatus;
+        printf("Error. Link page is not specified directive\n");
+        return 0;
+    }      
+
+    // a closure row lookup is the whole cost, the cache would only add to it
+    if (aGraph->engine == ENGINE_INCREMENTAL)
+        return closureQuery(aGraph->closure, fromPos, toPos);
+
+    int pathExists = cacheLookup(aGraph, fromPos, toPos);
+    if (pathExists == -1)
+    {
+        pathExists = reachable(aGraph, fromPos, toPos);
+        cacheStore(aGraph, fromPos, toPos, pathExists);
+    }
+    return pathExists;
+}
+
+/** @engine dfs|parallel|incremental -- selects the reachability engine used
+    by @isConnected. incremental builds the closure index once and then keeps
+    it up to date on every addLink; it is refused for graphs whose closure
+    needs more than CLOSURE_MAX_MB. */
+void setEngine(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
+{
+    char name[BUFFER_MAX_LEN];
+    if (sscanf(line, "%63s", name) != 1)
+    {
+        printf("Error. Engine is not specified directive\n");
+        *status = 1;
+        return;
+    }
+
+    if (strcmp(name, "dfs") == 0)
+        aGraph->engine = ENGINE_DFS;
+    else if (strcmp(name, "parallel") == 0)
+        aGraph->engine = ENGINE_PARALLEL;
+    else if (strcmp(name, "incremental") == 0)
+    {
+        if (aGraph->closure == NULL)
+            aGraph->closure = buildClosure(aGraph);
+        if (aGraph->closure == NULL)
+        {
+            printf("Error. Not enough memory for the incremental engine (limit %d MB)\n",
+                   CLOSURE_MAX_MB);
+            *status = 1;
+            return;
+        }
+        aGraph->engine = ENGINE_INCREMENTAL;
+        // queries bypass the cache from now on; emptying it also stops
+        // addLink from queuing targets for an invalidation nobody needs
+        aGraph->cache.invalidated += aGraph->cache.count;
+        cacheReset(&aGraph->cache, aGraph->cache.capacity);
+        aGraph->cache.numPending = 0;
+    }
+    else
+    {
+        printf("Error. Unknown engine %s\n", name);
+        *status = 1;
+    }
+
+    // the closure is only maintained while its engine is selected
+    if (aGraph->engine != ENGINE_INCREMENTAL)
+    {
+        freeClosure(aGraph->closure);
+        aGraph->closure = NULL;
+    }
+}
+
+/** reads the next whitespace separated word of line starting at *pos
+    into word, returns 0 when the line has no more words */
+static int nextWord(const char *line, size_t *pos, char word[BUFFER_MAX_LEN])
+{
+    int consumed = 0;
+    if (sscanf(line + *pos, "%63s%n", word, &consumed) != 1)
+        return 0;
+    *pos += consumed;
+    return 1;
+}
+
+/** @reachableFrom P -- prints every page reachable from P (P included)
+    in insertion order, computed by one traversal */
+void reachableFrom(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
+{
+    char fromPage[BUFFER_MAX_LEN];
+    size_t pos = 0;
+    if (!nextWord(line, &pos, fromPage))
+    {
+        printf("Error. Source page is not specified directive\n");
+        *status = 1;
+        return;
+    }
+    int fromPos = findPage(aGraph, fromPage);
+    if (fromPos == -1)
+    {
+        printf("Error. Source page is not specified directive\n");
+        *status = 1;
+        return;
+    }
+
+    struct csr *aCsr = currentCsr(aGraph);
+    _Atomic uint64_t *visited = calloc((aGraph->numVertices + 63) / 64, sizeof(uint64_t));
+    if (aCsr == NULL || visited == NULL || bfsReach(aCsr, fromPos, -1, visited) == -1)
+    {
+        free((void *)visited);
+        fprintf(stderr, "Fatal error: out of memory.\n");
+        exit(1);
+    }
+
+    const char *separator = "";
+    int i;
+    for (i=0; i < aGraph->numVertices; i++)
+    {
+        if (testBit(visited, i))
+        {
+            printf("%s%s", separator, aGraph->adjList[i]->value);
+            separator = " ";
+        }
+    }
+    printf("\n");
+    free((void *)visited);
+}
+
+/* msBfs(g, sources, numSources, seen) -- bit-parallel multi-source BFS.
+    Up to 64 sources are explored at once: bit k of seen[v] is set when
+    sources[k] reaches page v. seen must be zeroed, one word per page.
+    returns 0, or -1 if out of memory */
+int msBfs(const struct csr *g, const int *sources, int numSources, uint64_t *seen)
+{
+    int n = g->numVertices;
+    uint64_t *visit = calloc(n, sizeof(uint64_t));
+    uint64_t *visitNext = calloc(n, sizeof(uint64_t));
+    int *frontier = malloc(n * sizeof(int));
+    int *nextFrontier = malloc(n * sizeof(int));
+    if (visit == NULL || visitNext == NULL || frontier == NULL || nextFrontier == NULL)
+    {
+        free(visit);
+        free(visitNext);
+        free(frontier);
+        free(nextFrontier);
+        return -1;
+    }
+
+    int frontierSize = 0, k;
+    for (k = 0; k < numSources; k++)
+    {
+        int s = sources[k];
+        if (visit[s] == 0)
+            frontier[frontierSize++] = s;
+        visit[s] |= (uint64_t)1 << k;
+        seen[s] |= (uint64_t)1 << k;
+    }
+
+    while (frontierSize > 0)
+    {
+        int nextSize = 0, i;
+        for (i = 0; i < frontierSize; i++)
+        {
+            int v = frontier[i];
+            long e;
+            for (e = g->offsets[v]; e < g->offsets[v+1]; e++)
+            {
+                int w = g->targets[e];
+                uint64_t newBits = visit[v] & ~seen[w];
+                if (newBits == 0)
+                    continue;
+                if (visitNext[w] == 0)
+                    nextFrontier[nextSize++] = w;
+                visitNext[w] |= newBits;
+                seen[w] |= newBits;
+            }
+        }
+        for (i = 0; i < frontierSize; i++)
+            visit[frontier[i]] = 0;
+
+        uint64_t *tmpBits = visit;
+        visit = visitNext;
+        visitNext = tmpBits;
+        int *tmpList = frontier;
+        frontier = nextFrontier;
+        nextFrontier = tmpList;
+        frontierSize = nextSize;
+    }
+
+    free(visit);
+    free(visitNext);
+    free(frontier);
+    free(nextFrontier);
+    return 0;
+}
+
+/** answers the pairs that have both pages with cached results and msBfs
+    walks, grouped by source so 64 distinct sources share one walk */
+static void answerPairs(struct graph* aGraph, const int *from, const int *to, int numPairs, char *answer)
+{
+    // slot of each distinct source page: batch = slot / 64, bit = slot % 64.
+    // pairSlot holds the slot of each pair's source, -1 once it is answered
+    int n = aGraph->numVertices;
+    int *slotOf = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *sources = malloc((numPairs > 0 ? numPairs : 1) * sizeof(int));
+    int *pairSlot = malloc((numPairs > 0 ? numPairs : 1) * sizeof(int));
+    uint64_t *seen = malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+    struct csr *aCsr = currentCsr(aGraph);
+    if (slotOf == NULL || sources == NULL || pairSlot == NULL || seen == NULL || aCsr == NULL)
+    {
+        fprintf(stderr, "Fatal error: out of memory.\n");
+        exit(1);
+    }
+    memset(slotOf, -1, n * sizeof(int));
+    int numSources = 0, p;
+    for (p = 0; p < numPairs; p++)
+    {
+        pairSlot[p] = -1;
+        if (from[p] == -1 || to[p] == -1)
+            continue;
+        int cached = cacheLookup(aGraph, from[p], to[p]);
+        if (cached != -1)
+        {
+            answer[p] = cached;
+            continue;
+        }
+        if (slotOf[from[p]] == -1)
+        {
+            slotOf[from[p]] = numSources;
+            sources[numSources++] = from[p];
+        }
+        pairSlot[p] = slotOf[from[p]];
+    }
+
+    int batch;
+    for (batch = 0; batch * 64 < numSources; batch++)
+    {
+        int inBatch = numSources - batch * 64 < 64 ? numSources - batch * 64 : 64;
+        memset(seen, 0, n * sizeof(uint64_t));
+        if (msBfs(aCsr, sources + batch * 64, inBatch, seen) == -1)
+        {
+            fprintf(stderr, "Fatal error: out of memory.\n");
+            exit(1);
+        }
+        for (p = 0; p < numPairs; p++)
+        {
+            if (pairSlot[p] == -1 || pairSlot[p] / 64 != batch)
+                continue;
+            answer[p] = (seen[to[p]] >> (pairSlot[p] % 64)) & 1;
+            cacheStore(aGraph, from[p], to[p], answer[p]);
+        }
+    }
+
+    free(slotOf);
+    free(sources);
+    free(pairSlot);
+    free(seen);
+}
+
+/** @isConnectedMany A_1 B_1 A_2 B_2 . . . -- answers @isConnected for every
+    pair, one result line per pair in input order. The incremental engine
+    answers each pair from its closure, the others share msBfs walks. */
+void isConnectedMany(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
+{
+    size_t pos = 0;
+    int numPairs = 0, capacity = 0;
+    int *from = NULL, *to = NULL;
+    char fromPage[BUFFER_MAX_LEN], toPage[BUFFER_MAX_LEN];
+
+    while (nextWord(line, &pos, fromPage))
+    {
+        if (!nextWord(line, &pos, toPage))
+        {
+            printf("Error. Link page is not specified directive\n");
+            *status = 1;
+            break;
+        }
+        if (numPairs == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 64;
+            from = realloc(from, capacity * sizeof(int));
+            to = realloc(to, capacity * sizeof(int));
+        }
+        from[numPairs] = findPage(aGraph, fromPage);
+        to[numPairs] = findPage(aGraph, toPage);
+        numPairs++;
+    }
+
+    char *answer = calloc(numPairs > 0 ? numPairs : 1, 1);
+    if (answer == NULL)
+    {
+        fprintf(stderr, "Fatal error: out of memory.\n");
+        exit(1);
+    }
+    int p;
+    if (aGraph->engine == ENGINE_INCREMENTAL)
+    {
+        for (p = 0; p < numPairs; p++)
+            if (from[p] != -1 && to[p] != -1)
+                answer[p] = closureQuery(aGraph->closure, from[p], to[p]);
+    }
+    else
+        answerPairs(aGraph, from, to, numPairs, answer);
+
+    for (p = 0; p < numPairs; p++)
+    {
+        if (from[p] == -1)
+        {
+            printf("Error. Source page is not specified directive\n");
+            *status = 1;
+        }
+        else if (to[p] == -1)
+        {
+            printf("Error. Link page is not specified directive\n");
+            *status = 1;
+        }
+        printf("%d\n", answer[p]);
+    }
+
+    free(from);
+    free(to);
+    free(answer);
+}
+
+/** @cacheSize N -- enables the cache for up to N memoized answers, 0 disables it (the default) */
+void setCacheSize(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
+{
+    int maxEntries;
+    if (sscanf(line, "%d", &maxEntries) != 1 || maxEntries < 0)
+    {
+        printf("Error. Cache size is not specified directive\n");
+        *status = 1;
+        return;
+    }
+    aGraph->cache.maxEntries = maxEntries;
+    if (aGraph->cache.count > maxEntries)
+    {
+        aGraph->cache.evicted += aGraph->cache.count;
+        cacheReset(&aGraph->cache, aGraph->cache.capacity);
+    }
+}
+
+/** @cacheStats -- prints the reachability cache counters */
+void printCacheStats(struct graph* aGraph)
+{
+    struct reachCache *cache = &aGraph->cache;
+    printf("cache: %d entries (%d negative), limit %d, %ld hits, %ld misses, "
+           "%ld invalidated, %ld evicted\n",
+           cache->count, cache->numNegative, cache->maxEntries, cache->hits,
+           cache->misses, cache->invalidated, cache->evicted);
+}
+
+/** true if the page or link was allocated as part of a loaded checkpoint */
+static int inPageBlock(struct graph* aGraph, struct page *aPage)
+{
+    return aGraph->pageBlock != NULL && aPage >= aGraph->pageBlock &&
+           aPage < aGraph->pageBlock + aGraph->numBlockPages;
+}
+
+static int inLinkBlock(struct graph* aGraph, struct link *aLink)
+{
+    return aGraph->linkBlock != NULL && aLink >= aGraph->linkBlock &&
+           aLink < aGraph->linkBlock + aGraph->numBlockLinks;
+}
+
+/** frees every page, link and index, leaving an empty graph with the same
+    engine and cache settings */
+void clearGraph(struct graph* aGraph)
+{
+	int i;
+	for (i=0; i < aGraph->numVertices; i++)
+	{
+		struct link *current = aGraph->adjList[i]->links;
+
+		while (current != NULL)
+		{
+			struct link *temp = current;			
+			current = current->next;
+			if (!inLinkBlock(aGraph, temp))
+				free(temp);
+			temp=NULL;
+		}
+		if (aGraph->adjList[i] != NULL)
+		{
+			if (!inPageBlock(aGraph, aGraph->adjList[i]))
+				free(aGraph->adjList[i]);
+			aGraph->adjList[i] = NULL;
 		}
 	}
+	freeCsr(aGraph->csr);
+	freeClosure(aGraph->closure);
+	free(aGraph->nameSlots);
+	free(aGraph->cache.slots);
+	free(aGraph->cache.pendingTargets);
 	free(aGraph->adjList);
+	free(aGraph->pageBlock);
+	free(aGraph->linkBlock);
+	if (aGraph->mapping != NULL)
+		munmap(aGraph->mapping, aGraph->mappingSize);
+
+	int engine = aGraph->engine;
+	int maxEntries = aGraph->cache.maxEntries;
+	memset(aGraph, 0, sizeof(struct graph));
+	aGraph->engine = engine;
+	aGraph->csrDirty = 1;
+	aGraph->cache.maxEntries = maxEntries;
+}
+
+void destroy(struct graph* aGraph)
+{
+	clearGraph(aGraph);
 	free(aGraph);
 }
 
+/* ---------------- binary checkpoints (@save / @load) ----------------
+
+   A checkpoint is the header below followed by these sections, each
+   starting on an 8 byte boundary:
+     names       numVertices records of BUFFER_MAX_LEN bytes
+     nameSlots   nameCapacity ints
+     offsets     numVertices+1 longs, then targets (numEdges ints)
+     inOffsets   numVertices+1 longs, then inSources (numEdges ints)
+     closure     if CHECKPOINT_CLOSURE: parent (numVertices ints),
+                 reps (numReps ints), then numReps rows of closureWords
+   Integers are stored in native form, so the csr arrays are used straight
+   from the mapping on load. */
+
+#define CHECKPOINT_MAGIC "LNKGRAPH"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_CLOSURE 1
+
+struct checkpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t longSize;
+    uint32_t flags;
+    int64_t numVertices;
+    int64_t numEdges;
+    int64_t nameCapacity;
+    int64_t closureWords;
+    int64_t closureReps;
+};
+
+static size_t align8(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+/** writes size bytes and pads to the next 8 byte boundary, returns 0 on success */
+static int writeSection(FILE *fp, const void *data, size_t size)
+{
+    static const char zeros[8];
+    if (size > 0 && fwrite(data, 1, size, fp) != size)
+        return -1;
+    if (align8(size) != size && fwrite(zeros, 1, align8(size) - size, fp) != align8(size) - size)
+        return -1;
+    return 0;
+}
+
+/** @save file -- writes the graph to a checkpoint file */
+void saveGraph(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
+{
+    char path[4096];
+    if (sscanf(line, "%4095s", path) != 1)
+    {
+        printf("Error. Checkpoint file is not specified directive\n");
+        *status = 1;
+        return;
+    }
+    // the checkpoint is written beside path and renamed over it, so a
+    // graph loaded from path keeps its mapping of the old file
+    char tempPath[4096 + 8];
+    snprintf(tempPath, sizeof tempPath, "%s.tmp", path);
+    struct csr *aCsr = currentCsr(aGraph);
+    FILE *fp = fopen(tempPath, "wb");
+    if (aCsr == NULL || fp == NULL)
+    {
+        if (fp != NULL)
+            fclose(fp);
+        printf("Error. Cannot write checkpoint %s\n", path);
+        *status = 1;
+        return;
+    }
+
+    struct closure *c = aGraph->closure;
+    struct checkpointHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof header.magic);
+    header.version = CHECKPOINT_VERSION;
+    header.byteOrder = 0x01020304;
+    header.longSize = sizeof(long);
+    header.flags = c != NULL ? CHECKPOINT_CLOSURE : 0;
+    header.numVertices = aGraph->numVertices;
+    header.numEdges = aCsr->numEdges;
+    header.nameCapacity = aGraph->nameCapacity;
+    header.closureWords = c != NULL ? c->words : 0;
+    header.closureReps = c != NULL ? c->numReps : 0;
+
+    int failed = writeSection(fp, &header, sizeof header);
+    char record[BUFFER_MAX_LEN];
+    int i;
+    for (i = 0; i < aGraph->numVertices && !failed; i++)
+    {
+        memset(record, 0, sizeof record);
+        strcpy(record, aGraph->adjList[i]->value);
+        failed = fwrite(record, 1, sizeof record, fp) != sizeof record;
+    }
+    long n = aGraph->numVertices, m = aCsr->numEdges;
+    failed = failed || writeSection(fp, aGraph->nameSlots, aGraph->nameCapacity * sizeof(int));
+    failed = failed || writeSection(fp, aCsr->offsets, (n+1) * sizeof(long));
+    failed = failed || writeSection(fp, aCsr->targets, m * sizeof(int));
+    failed = failed || writeSection(fp, aCsr->inOffsets, (n+1) * sizeof(long));
+    failed = failed || writeSection(fp, aCsr->inSources, m * sizeof(int));
+    if (c != NULL)
+    {
+        // point every page straight at its rep, as loadGraph expects
+        for (i = 0; i < n; i++)
+            c->parent[i] = closureFind(c, i);
+        failed = failed || writeSection(fp, c->parent, n * sizeof(int));
+        failed = failed || writeSection(fp, c->reps, c->numReps * sizeof(int));
+        for (i = 0; i < c->numReps && !failed; i++)
+            failed = writeSection(fp, c->rows[c->reps[i]], c->words * sizeof(uint64_t));
+    }
+    if (fclose(fp) != 0 || failed || rename(tempPath, path) != 0)
+    {
+        unlink(tempPath);
+        printf("Error. Cannot write checkpoint %s\n", path);
+        *status = 1;
+    }
+}
+
+/** rebuilds the closure from its checkpoint sections and the links of g,
+    returns NULL if out of memory or over CLOSURE_MAX_MB */
+static struct closure* loadClosure(const struct checkpointHeader *header,
+        const int *parent, const int *reps, const uint64_t *rows, const struct csr *g)
+{
+    if (!closureFits(header->closureReps, header->closureWords))
+        return NULL;
+    struct closure *c = calloc(1, sizeof(struct closure));
+    if (c == NULL)
+        return NULL;
+    int n = (int)header->numVertices;
+    c->capacity = (int)header->closureWords * 64;
+    c->words = (int)header->closureWords;
+    c->numVertices = n;
+    c->parent = malloc((c->capacity > 0 ? c->capacity : 1) * sizeof(int));
+    c->reps = malloc((c->capacity > 0 ? c->capacity : 1) * sizeof(int));
+    c->repPos = malloc((c->capacity > 0 ? c->capacity : 1) * sizeof(int));
+    c->rows = calloc(c->capacity > 0 ? c->capacity : 1, sizeof(uint64_t *));
+    c->preds = calloc(c->capacity > 0 ? c->capacity : 1, sizeof(struct predList));
+    c->mark = calloc(c->capacity > 0 ? c->capacity : 1, sizeof(int));
+    c->queue = malloc((c->capacity > 0 ? c->capacity : 1) * sizeof(int));
+    if (c->parent == NULL || c->reps == NULL || c->repPos == NULL || c->rows == NULL ||
+        c->preds == NULL || c->mark == NULL || c->queue == NULL)
+    {
+        freeClosure(c);
+        return NULL;
+    }
+    memcpy(c->parent, parent, n * sizeof(int));
+    for (int i = 0; i < header->closureReps; i++)
+    {
+        int x = reps[i];
+        c->rows[x] = malloc(c->words * sizeof(uint64_t));
+        if (c->rows[x] == NULL)
+        {
+            freeClosure(c);
+            return NULL;
+        }
+        memcpy(c->rows[x], rows + (size_t)i * c->words, c->words * sizeof(uint64_t));
+        closureAddRep(c, x);
+    }
+    // the links between components are not saved, the csr has them all
+    for (int x = 0; x < n; x++)
+        for (long e = g->offsets[x]; e < g->offsets[x+1]; e++)
+        {
+            int cx = closureFind(c, x), cy = closureFind(c, g->targets[e]);
+            if (cx != cy && closureAddPred(c, cy, x) == -1)
+            {
+                freeClosure(c);
+                return NULL;
+            }
+        }
+    return c;
+}
+
+/** checks that a mapped offsets/ids pair describes n pages and m links */
+static int validCsrArrays(const long *offsets, const int *ids, int64_t n, int64_t m)
+{
+    int64_t i;
+    if (offsets[0] != 0 || offsets[n] != m)
+        return 0;
+    for (i = 0; i < n; i++)
+        if (offsets[i+1] < offsets[i])
+            return 0;
+    for (i = 0; i < m; i++)
+        if (ids[i] < 0 || ids[i] >= n)
+            return 0;
+    return 1;
+}
+
+/** checks that every name slot is free (-1) or holds a page id below n */
+static int validNameSlots(const int *slots, int64_t capacity, int64_t n)
+{
+    // findPage masks with capacity - 1 and needs a free slot to stop at
+    if (capacity != 0 && ((capacity & (capacity - 1)) != 0 || capacity < 2 * n))
+        return 0;
+    for (int64_t i = 0; i < capacity; i++)
+        if (slots[i] < -1 || slots[i] >= n)
+            return 0;
+    return 1;
+}
+
+/** checks that the closure reps are distinct pages below n, each its own
+    parent, and that every page's parent is one of them */
+static int validClosureArrays(const int *parent, const int *reps, int64_t numReps, int64_t n)
+{
+    char *isRep = calloc(n > 0 ? n : 1, 1);
+    if (isRep == NULL)
+        return 0;
+    int valid = 1;
+    int64_t i;
+    for (i = 0; i < numReps && valid; i++)
+    {
+        valid = reps[i] >= 0 && reps[i] < n && !isRep[reps[i]] && parent[reps[i]] == reps[i];
+        if (valid)
+            isRep[reps[i]] = 1;
+    }
+    for (i = 0; i < n && valid; i++)
+        valid = parent[i] >= 0 && parent[i] < n && isRep[parent[i]];
+    free(isRep);
+    return valid;
+}
+
+/** @load file -- replaces the graph with the contents of a checkpoint */
+void loadGraph(struct graph* aGraph, char line[BUFFER_MAX_LEN], int *status)
+{
+    char path[4096];
+    if (sscanf(line, "%4095s", path) != 1)
+    {
+        printf("Error. Checkpoint file is not specified directive\n");
+        *status = 1;
+        return;
+    }
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(struct checkpointHeader))
+    {
+        if (fd != -1)
+            close(fd);
+        printf("Error. Cannot read checkpoint %s\n", path);
+        *status = 1;
+        return;
+    }
+    size_t size = info.st_size;
+    char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        printf("Error. Cannot read checkpoint %s\n", path);
+        *status = 1;
+        return;
+    }
+
+    // locate and bounds check every section before touching the graph
+    struct checkpointHeader header;
+    memcpy(&header, base, sizeof header);
+    int64_t n = header.numVertices, m = header.numEdges;
+    int valid = memcmp(header.magic, CHECKPOINT_MAGIC, sizeof header.magic) == 0 &&
+                header.version == CHECKPOINT_VERSION && header.byteOrder == 0x01020304 &&
+                header.longSize == sizeof(long) && n >= 0 && n < INT32_MAX && m >= 0 &&
+                m <= (int64_t)size && header.nameCapacity >= 0 && header.nameCapacity < INT32_MAX &&
+                header.closureWords >= 0 && header.closureWords <= INT32_MAX / 64 &&
+                header.closureReps >= 0 && header.closureReps <= n;
+    size_t at = align8(sizeof header);
+    size_t namesAt = at;
+    at += align8((size_t)n * BUFFER_MAX_LEN);
+    size_t slotsAt = at;
+    at += align8((size_t)header.nameCapacity * sizeof(int));
+    size_t offsetsAt = at;
+    at += align8((size_t)(n+1) * sizeof(long));
+    size_t targetsAt = at;
+    at += align8((size_t)m * sizeof(int));
+    size_t inOffsetsAt = at;
+    at += align8((size_t)(n+1) * sizeof(long));
+    size_t inSourcesAt = at;
+    at += align8((size_t)m * sizeof(int));
+    size_t parentAt = at, repsAt = at, rowsAt = at;
+    if (header.flags & CHECKPOINT_CLOSURE)
+    {
+        at += align8((size_t)n * sizeof(int));
+        repsAt = at;
+        at += align8((size_t)header.closureReps * sizeof(int));
+        rowsAt = at;
+        at += (size_t)header.closureReps * header.closureWords * sizeof(uint64_t);
+        valid = valid && header.closureWords * 64 >= n;
+    }
+    if (valid && at <= size)
+    {
+        valid = validCsrArrays((const long *)(base + offsetsAt), (const int *)(base + targetsAt), n, m) &&
+                validCsrArrays((const long *)(base + inOffsetsAt), (const int *)(base + inSourcesAt), n, m) &&
+                validNameSlots((const int *)(base + slotsAt), header.nameCapacity, n);
+        if (valid && (header.flags & CHECKPOINT_CLOSURE))
+            valid = validClosureArrays((const int *)(base + parentAt), (const int *)(base + repsAt),
+                                       header.closureReps, n);
+    }
+    if (!valid || at > size)
+    {
+        munmap(base, size);
+        printf("Error. %s is not a valid checkpoint\n", path);
+        *status = 1;
+        return;
+    }
+
+    clearGraph(aGraph);
+    aGraph->mapping = base;
+    aGraph->mappingSize = size;
+
+    struct csr *aCsr = calloc(1, sizeof(struct csr));
+    struct page *pages = malloc((n > 0 ? n : 1) * sizeof(struct page));
+    struct link *links = malloc((m > 0 ? m : 1) * sizeof(struct link));
+    struct page **adjList = malloc((n > 0 ? n : 1) * sizeof(struct page *));
+    int *nameSlots = malloc((header.nameCapacity > 0 ? header.nameCapacity : 1) * sizeof(int));
+    if (aCsr == NULL || pages == NULL || links == NULL || adjList == NULL || nameSlots == NULL)
+    {
+        free(aCsr); free(pages); free(links); free(adjList); free(nameSlots);
+        printf("Error. Not enough memory to load checkpoint %s\n", path);
+        *status = 1;
+        return;
+    }
+
+    aCsr->numVertices = (int)n;
+    aCsr->numEdges = m;
+    aCsr->offsets = (long *)(base + offsetsAt);
+    aCsr->targets = (int *)(base + targetsAt);
+    aCsr->inOffsets = (long *)(base + inOffsetsAt);
+    aCsr->inSources = (int *)(base + inSourcesAt);
+    aCsr->mapped = 1;
+
+    long i, e;
+    for (i = 0; i < n; i++)
+    {
+        struct page *current = &pages[i];
+        memcpy(current->value, base + namesAt + i * BUFFER_MAX_LEN, BUFFER_MAX_LEN);
+        current->value[BUFFER_MAX_LEN-1] = '\0';
+        current->visited = 0;
+        current->id = (int)i;
+        current->numLinks = (int)(aCsr->offsets[i+1] - aCsr->offsets[i]);
+        current->links = NULL;
+        for (e = aCsr->offsets[i+1] - 1; e >= aCsr->offsets[i]; e--)
+        {
+            links[e].toPage = &pages[aCsr->targets[e]];
+            links[e].next = current->links;
+            current->links = &links[e];
+        }
+        adjList[i] = current;
+    }
+    memcpy(nameSlots, base + slotsAt, header.nameCapacity * sizeof(int));
+
+    aGraph->numVertices = (int)n;
+    aGraph->numEdges = m;
+    aGraph->adjList = adjList;
+    aGraph->nameSlots = nameSlots;
+    aGraph->nameCapacity = (int)header.nameCapacity;
+    aGraph->pageBlock = pages;
+    aGraph->numBlockPages = (int)n;
+    aGraph->linkBlock = links;
+    aGraph->numBlockLinks = m;
+    aGraph->csr = aCsr;
+    aGraph->csrDirty = 0;
+
+    if (header.flags & CHECKPOINT_CLOSURE)
+    {
+        aGraph->closure = loadClosure(&header, (const int *)(base + parentAt),
+                (const int *)(base + repsAt), (const uint64_t *)(base + rowsAt), aCsr);
+        if (aGraph->closure != NULL)
+            aGraph->engine = ENGINE_INCREMENTAL;
+    }
+    if (aGraph->engine == ENGINE_INCREMENTAL && aGraph->closure == NULL)
+        aGraph->closure = buildClosure(aGraph);
+    if (aGraph->engine == ENGINE_INCREMENTAL && aGraph->closure == NULL)
+        dropClosure(aGraph);
+}
+
+/* directive timing, enabled by setting LINKED_TIMING in the environment.
+   The summary goes to stderr as one key=value line so benchmark drivers
+   can parse it. */
+struct timing
+{
+    int enabled;
+    long directives;
+    double seconds;
+    double *latencies;    // of every @isConnected, in seconds
+    long numLatencies;
+    long capacity;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/** nearest-rank percentile of sorted values, in microseconds */
+static double percentile(const double *sorted, long count, double p)
+{
+    if (count == 0)
+        return 0;
+    long rank = (long)(p / 100 * count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+    return sorted[rank-1] * 1e6;
+}
+
+void recordLatency(struct timing *timer, double seconds)
+{
+    if (timer->numLatencies == timer->capacity)
+    {
+        long capacity = timer->capacity ? 2 * timer->capacity : 1024;
+        double *latencies = realloc(timer->latencies, capacity * sizeof(double));
+        if (latencies == NULL)
+            return;
+        timer->latencies = latencies;
+        timer->capacity = capacity;
+    }
+    timer->latencies[timer->numLatencies++] = seconds;
+}
+
+void printTiming(struct timing *timer)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    qsort(timer->latencies, timer->numLatencies, sizeof(double), compareDoubles);
+    fprintf(stderr, "timing: directives=%ld seconds=%.6f directives_per_sec=%.1f "
+            "isConnected=%ld p50_us=%.2f p90_us=%.2f p99_us=%.2f max_us=%.2f peak_rss_kb=%ld\n",
+            timer->directives, timer->seconds,
+            timer->seconds > 0 ? timer->directives / timer->seconds : 0.0,
+            timer->numLatencies,
+            percentile(timer->latencies, timer->numLatencies, 50),
+            percentile(timer->latencies, timer->numLatencies, 90),
+            percentile(timer->latencies, timer->numLatencies, 99),
+            percentile(timer->latencies, timer->numLatencies, 100),
+            usage.ru_maxrss);
+    free(timer->latencies);
+}
+
 void readInput(FILE* fp, struct graph* aGraph, int *status)
 {    
     int tempStatus = *status;
 
     ssize_t numCharsRead = 0;
     char *line = NULL;
-    size_t lineSize = BUFFER_MAX_LEN;
+    size_t lineSize = 0;
+    struct timing timer;
+    memset(&timer, 0, sizeof timer);
+    timer.enabled = getenv("LINKED_TIMING") != NULL;
+    double started = now();
   
     while ((numCharsRead = getline(&line, &lineSize, fp)) != -1)
     {
         if (fp == stdin && ( strcmp(line, "EOF\n") == 0 || strcmp(line, "eof\n") == 0) )
             break;
 
-        if (numCharsRead < 9)
+        char op[BUFFER_MAX_LEN];
+        int numFilled = sscanf(line, "%63s", op);
+        if (numFilled < 1)
         {
           printf("Error. invalid directive\n");
           tempStatus = 1;
           continue;
         }
-        
-        char op[BUFFER_MAX_LEN];
-        int numFilled = sscanf(line, "%s", op);
-        if (numFilled < 1)
+
+        // @save and @load take a path, which may be a single character
+        int isCheckpoint = strcmp(op, "@save") == 0 || strcmp(op, "@load") == 0;
+        if (numCharsRead < 9 && !isCheckpoint)
         {
           printf("Error. invalid directive\n");
           tempStatus = 1;
@@ -282,18 +2190,40 @@ void readInput(FILE* fp, struct graph* aGraph, int *status)
             addLinks(aGraph, line+strlen(op)+1, status);
         else if (strcmp(op, "@isConnected") == 0)
         {
+            double queryStarted = timer.enabled ? now() : 0;
             int pathExists = isConnected(aGraph, line+strlen(op)+1, status);
+            if (timer.enabled)
+                recordLatency(&timer, now() - queryStarted);
             printf("%d\n", pathExists);
         }
+        else if (strcmp(op, "@reachableFrom") == 0)
+            reachableFrom(aGraph, line+strlen(op)+1, status);
+        else if (strcmp(op, "@isConnectedMany") == 0)
+            isConnectedMany(aGraph, line+strlen(op)+1, status);
+        else if (strcmp(op, "@engine") == 0)
+            setEngine(aGraph, line+strlen(op)+1, status);
+        else if (strcmp(op, "@cacheSize") == 0)
+            setCacheSize(aGraph, line+strlen(op)+1, status);
+        else if (strcmp(op, "@cacheStats") == 0)
+            printCacheStats(aGraph);
+        else if (strcmp(op, "@save") == 0)
+            saveGraph(aGraph, line+strlen(op)+1, status);
+        else if (strcmp(op, "@load") == 0)
+            loadGraph(aGraph, line+strlen(op)+1, status);
         else
         {
             tempStatus = 1;
             printf("Error. Invalid directive\n");
         }
-		free(line);
-        line = NULL;
+        timer.directives++;
     }
+    free(line);
     
+    if (timer.enabled)
+    {
+        timer.seconds = now() - started;
+        printTiming(&timer);
+    }
     status = &tempStatus;
     fclose(fp);
 }
@@ -318,16 +2248,24 @@ int main(int argc, char * argv[])
     else
     {
         fp = stdin;
-        printf("Enter your directive in the form operation args. Only three operations allowed:\n");
+        printf("Enter your directive in the form operation args. Only ten operations allowed:\n");
         printf("operation 1: @addPages Name_1 Name_2 . . . Name_n\n");
         printf("operation 2: @addLinks sourcePage Page_1 Page_2 . . . Page_n\n");
         printf("operation 3: @isConnected Page_1 Page_2\n");
+        printf("operation 4: @reachableFrom Page_1\n");
+        printf("operation 5: @isConnectedMany Page_1 Page_2 . . . Page_2n-1 Page_2n\n");
+        printf("operation 6: @engine dfs|parallel|incremental\n");
+        printf("operation 7: @cacheSize N\n");
+        printf("operation 8: @cacheStats\n");
+        printf("operation 9: @save file\n");
+        printf("operation 10: @load file\n");
         printf("Type EOF to mark the end of all directives.\n");
     }
 
     
-    struct graph* aGraph = malloc(sizeof(struct graph));
-    aGraph->numVertices = 0;
+    struct graph* aGraph = calloc(1, sizeof(struct graph));
+    aGraph->engine = ENGINE_DFS;
+    aGraph->csrDirty = 1;
     
     readInput(fp, aGraph, &status);
     destroy(aGraph);
@@ -0,0 +1,367 @@
+/*
+ * directive-script generator and benchmark driver for linked.c
+ *
+ * gen mode writes an @addPages/@addLinks/@isConnected script modelled on a
+ * web crawl: a giant strongly connected core with power-law out-degree,
+ * in-tendrils leading into it, out-tendrils hanging off it, long chains
+ * and small disconnected islands. run mode generates scripts of growing
+ * size, runs linked on each with LINKED_TIMING set and tabulates directive
+ * throughput, @isConnected latency percentiles and peak RSS.
+ *
+ *   ./linkedBench gen [options] > script.txt
+ *   ./linkedBench run [options] [-b ./linked] [-from N] [-to N] [-f factor]
+ *
+ * options: -n pages, -d average core out-degree, -a power-law exponent,
+ *          -c chain length, -q queries, -m single,many,reach query mix in
+ *          percent, -e engine, -s seed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define NAMES_PER_LINE 64    // keeps every directive line short
+#define MAX_DEGREE 1000
+#define PAIRS_PER_MANY 32
+
+typedef struct {
+    long pages;
+    double degree;      // average out-degree inside the core
+    double exponent;    // power-law exponent of the core out-degree
+    long chainLength;
+    long queries;
+    int mix[3];         // percent of @isConnected, @isConnectedMany, @reachableFrom
+    char engine[32];
+    unsigned long long seed;
+} Params;
+
+/* page layout: [core | in-tendrils | out-tendrils | chains | islands] */
+typedef struct {
+    long core, inStart, outStart, chainStart, islandStart, end;
+} Layout;
+
+/* ------------------- PART I -- GENERATOR --------------------- */
+
+static unsigned long long rngState;
+
+/*
+ * xorshift64* -- returns the next 64 random bits
+ */
+static unsigned long long nextRandom()
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+/*
+ * uniform random number in [0, n)
+ */
+static long randomBelow(long n)
+{
+    return (long)(nextRandom() % (unsigned long long)n);
+}
+
+/*
+ * uniform random number in [0, 1)
+ */
+static double randomUnit()
+{
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * out-degree drawn from a Pareto distribution with the configured mean
+ */
+static long powerLawDegree(const Params *p)
+{
+    double a = p->exponent;
+    double xmin = a > 2 ? p->degree * (a - 2) / (a - 1) : 1;
+    double d = xmin * pow(1 - randomUnit(), -1 / (a - 1));
+    return d > MAX_DEGREE ? MAX_DEGREE : (long)(d + 0.5);
+}
+
+static Layout makeLayout(const Params *p)
+{
+    Layout l;
+    l.core = p->pages / 2;
+    if (l.core < 1)
+        l.core = 1;
+    l.inStart = l.core;
+    l.outStart = l.inStart + p->pages * 15 / 100;
+    l.chainStart = l.outStart + p->pages * 15 / 100;
+    l.islandStart = l.chainStart + p->pages * 10 / 100;
+    l.end = p->pages > l.islandStart ? p->pages : l.islandStart;
+    return l;
+}
+
+/*
+ * buffered @addLinks line for one source page, flushed every NAMES_PER_LINE targets
+ */
+typedef struct {
+    FILE *fp;
+    long source;
+    int count;
+    long total;
+} LinkLine;
+
+static void linkTo(LinkLine *line, long target)
+{
+    if (line->count == 0)
+        fprintf(line->fp, "@addLinks p%ld", line->source);
+    fprintf(line->fp, " p%ld", target);
+    line->total++;
+    if (++line->count == NAMES_PER_LINE) {
+        fputc('\n', line->fp);
+        line->count = 0;
+    }
+}
+
+static void endLinks(LinkLine *line)
+{
+    if (line->count > 0)
+        fputc('\n', line->fp);
+    line->count = 0;
+}
+
+/*
+ * picks a core page, skewed toward low ids so in-degree is heavy-tailed too
+ */
+static long popularCorePage(const Layout *l)
+{
+    double u = randomUnit();
+    return (long)(u * u * l->core);
+}
+
+/*
+ * writes the links of one page according to its region of the layout
+ */
+static void pageLinks(const Params *p, const Layout *l, LinkLine *line, long v)
+{
+    if (v < l->core) {                       // giant SCC: cycle + power law
+        linkTo(line, (v + 1) % l->core);
+        long d = powerLawDegree(p);
+        for (long k = 0; k < d; k++)
+            linkTo(line, popularCorePage(l));
+        if (l->chainStart > l->outStart && randomUnit() < 0.3)
+            linkTo(line, l->outStart + randomBelow(l->chainStart - l->outStart));
+    } else if (v < l->outStart) {            // in-tendril: leads into the core
+        if (v > l->inStart && randomUnit() < 0.5)
+            linkTo(line, l->inStart + randomBelow(v - l->inStart));
+        else
+            linkTo(line, popularCorePage(l));
+    } else if (v < l->chainStart) {          // out-tendril: only links further out
+        if (v + 1 < l->chainStart && randomUnit() < 0.5)
+            linkTo(line, v + 1 + randomBelow(l->chainStart - v - 1 < 64 ? l->chainStart - v - 1 : 64));
+    } else if (v < l->islandStart) {         // chains ending in the core
+        long pos = (v - l->chainStart) % p->chainLength;
+        if (pos + 1 < p->chainLength && v + 1 < l->islandStart)
+            linkTo(line, v + 1);
+        else
+            linkTo(line, popularCorePage(l));
+    } else {                                 // islands of 16 pages
+        long base = v - (v - l->islandStart) % 16;
+        long size = l->end - base < 16 ? l->end - base : 16;
+        linkTo(line, base + randomBelow(size));
+    }
+    endLinks(line);
+}
+
+/*
+ * writes a whole script to fp, returns the number of links generated
+ */
+long generate(FILE *fp, const Params *p)
+{
+    Layout l = makeLayout(p);
+    rngState = p->seed ? p->seed : 1;
+
+    if (p->engine[0])
+        fprintf(fp, "@engine %s\n", p->engine);
+
+    for (long v = 0; v < l.end; v += NAMES_PER_LINE) {
+        fprintf(fp, "@addPages");
+        for (long k = v; k < v + NAMES_PER_LINE && k < l.end; k++)
+            fprintf(fp, " p%ld", k);
+        fputc('\n', fp);
+    }
+
+    LinkLine line = { fp, 0, 0, 0 };
+    for (long v = 0; v < l.end; v++) {
+        line.source = v;
+        pageLinks(p, &l, &line, v);
+    }
+
+    for (long q = 0; q < p->queries; q++) {
+        long r = randomBelow(100);
+        if (r < p->mix[0]) {
+            fprintf(fp, "@isConnected p%ld p%ld\n", randomBelow(l.end), randomBelow(l.end));
+        } else if (r < p->mix[0] + p->mix[1]) {
+            long sources[4];
+            for (int k = 0; k < 4; k++)
+                sources[k] = randomBelow(l.end);
+            fprintf(fp, "@isConnectedMany");
+            for (int k = 0; k < PAIRS_PER_MANY; k++)
+                fprintf(fp, " p%ld p%ld", sources[k % 4], randomBelow(l.end));
+            fputc('\n', fp);
+        } else {
+            fprintf(fp, "@reachableFrom p%ld\n", randomBelow(l.end));
+        }
+    }
+    return line.total;
+}
+
+
+/* ------------------- PART II -- DRIVER --------------------- */
+
+/*
+ * runs linked on the script with LINKED_TIMING set, copies its timing line
+ * into timing and the peak RSS reported by the kernel into *peakKb
+ * returns 0 if OK, -1 if the run failed
+ */
+static int runLinked(const char *linked, const char *script, char *timing, size_t size, long *peakKb)
+{
+    int fds[2];
+    if (pipe(fds) == -1)
+        return -1;
+    pid_t pid = fork();
+    if (pid == -1)
+        return -1;
+    if (pid == 0) {
+        FILE *devnull = fopen("/dev/null", "w");
+        if (devnull != NULL)
+            dup2(fileno(devnull), STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        setenv("LINKED_TIMING", "1", 1);
+        execl(linked, linked, script, (char *)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    // keep only the timing line, the rest of stderr is passed through
+    FILE *err = fdopen(fds[0], "r");
+    char buf[1024];
+    timing[0] = '\0';
+    while (err != NULL && fgets(buf, sizeof buf, err) != NULL) {
+        if (strncmp(buf, "timing:", 7) == 0)
+            snprintf(timing, size, "%s", buf);
+        else
+            fputs(buf, stderr);
+    }
+    if (err != NULL)
+        fclose(err);
+
+    int wstatus;
+    struct rusage usage;
+    if (wait4(pid, &wstatus, 0, &usage) == -1)
+        return -1;
+    *peakKb = usage.ru_maxrss;
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) == 127 || timing[0] == '\0')
+        return -1;
+    return 0;
+}
+
+static int runBenchmarks(Params *p, const char *linked, long from, long to, long factor)
+{
+    int return_status = 0;
+    printf("%10s %10s %10s %12s %10s %10s %10s %10s %10s\n", "pages", "links", "directives",
+           "dir/sec", "p50_us", "p90_us", "p99_us", "max_us", "rss_mb");
+    for (long n = from; n <= to; n *= factor) {
+        char script[] = "/tmp/linkedBench.XXXXXX";
+        int fd = mkstemp(script);
+        FILE *fp = fd == -1 ? NULL : fdopen(fd, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Cannot create script file\n");
+            return 1;
+        }
+        p->pages = n;
+        long links = generate(fp, p);
+        fclose(fp);
+
+        char timing[1024];
+        long peakKb = 0, directives = 0, count = 0;
+        double seconds = 0, rate = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+        if (runLinked(linked, script, timing, sizeof timing, &peakKb) == -1 ||
+            sscanf(timing, "timing: directives=%ld seconds=%lf directives_per_sec=%lf "
+                   "isConnected=%ld p50_us=%lf p90_us=%lf p99_us=%lf max_us=%lf",
+                   &directives, &seconds, &rate, &count, &p50, &p90, &p99, &max) != 8) {
+            fprintf(stderr, "run with %ld pages failed\n", n);
+            return_status = 1;
+        } else {
+            printf("%10ld %10ld %10ld %12.1f %10.2f %10.2f %10.2f %10.2f %10.1f\n",
+                   n, links, directives, rate, p50, p90, p99, max, peakKb / 1024.0);
+            fflush(stdout);
+        }
+        unlink(script);
+        if (factor < 2)
+            break;
+    }
+    return return_status;
+}
+
+
+/* ----------------------- PART III -- MAIN() --------- */
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ./linkedBench gen|run [-n pages] [-d degree] [-a exponent] "
+            "[-c chainLength] [-q queries] [-m single,many,reach] [-e engine] [-s seed]\n"
+            "       run also takes [-b ./linked] [-from N] [-to N] [-f factor]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    Params p = { 10000, 8, 2.1, 1000, 1000, { 95, 5, 0 }, "parallel", 1 };
+    const char *linked = "./linked";
+    long from = 1000, to = 10000000, factor = 10;
+
+    if (argc < 2 || (strcmp(argv[1], "gen") != 0 && strcmp(argv[1], "run") != 0))
+        usage();
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage();
+        const char *opt = argv[i], *val = argv[++i];
+        if (strcmp(opt, "-n") == 0)
+            p.pages = atol(val);
+        else if (strcmp(opt, "-d") == 0)
+            p.degree = atof(val);
+        else if (strcmp(opt, "-a") == 0)
+            p.exponent = atof(val);
+        else if (strcmp(opt, "-c") == 0)
+            p.chainLength = atol(val);
+        else if (strcmp(opt, "-q") == 0)
+            p.queries = atol(val);
+        else if (strcmp(opt, "-m") == 0) {
+            if (sscanf(val, "%d,%d,%d", &p.mix[0], &p.mix[1], &p.mix[2]) != 3)
+                usage();
+        } else if (strcmp(opt, "-e") == 0)
+            snprintf(p.engine, sizeof p.engine, "%s", val);
+        else if (strcmp(opt, "-s") == 0)
+            p.seed = strtoull(val, NULL, 10);
+        else if (strcmp(opt, "-b") == 0)
+            linked = val;
+        else if (strcmp(opt, "-from") == 0)
+            from = atol(val);
+        else if (strcmp(opt, "-to") == 0)
+            to = atol(val);
+        else if (strcmp(opt, "-f") == 0)
+            factor = atol(val);
+        else
+            usage();
+    }
+    if (p.pages < 1 || p.exponent <= 1 || p.chainLength < 1 || p.queries < 0 || from < 1)
+        usage();
+
+    if (strcmp(argv[1], "gen") == 0) {
+        generate(stdout, &p);
+        return 0;
+    }
+    return runBenchmarks(&p, linked, from, to, factor);
+}
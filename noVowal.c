@@ -8,6 +8,25 @@ noVowal.c
 #include <memory.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+#define KEY_SIZE 80
+#define ARENA_BLOCK (1 << 20)
+#define READ_BLOCK (1 << 20)
 
 typedef struct strNode
 {
@@ -18,191 +37,1837 @@ typedef struct strNode
 typedef struct node
 {
     struct strNode *str;
+    struct strNode *tail;
+    char *key;
+    unsigned long first;    // input position of the first word, for -j merging
     struct node *next;
 } node;
 
+typedef struct groupTable
+{
+    node **slots;
+    size_t capacity;
+    size_t count;
+    node *last;
+} groupTable;
+
 void memoryError()
 {
     printf("ERROR: Memory allocation failed\n");
     exit(1);
 }
 
-int isNoVowelEqual(char w1[], char w2[])
+/*
+ * work counters, reported on stderr when NOVOWAL_STATS is set. Every thread
+ * counts into its own copy and adds it to the totals when its job is done.
+ * Words are grouped by skeleton key, so hash probes and key comparisons
+ * measure the grouping work that pairwise word comparisons used to.
+ */
+typedef struct counters
+{
+    unsigned long words;
+    unsigned long groups;
+    unsigned long probes;       // hash table slots looked at
+    unsigned long compares;     // key comparisons in tables, sorts, merges and searches
+    unsigned long trieVisits;   // trie nodes looked at by -a
+    unsigned long mallocs;      // arena blocks and growing tables
+    unsigned long bytes;        // handed out by the arenas
+} counters;
+
+static __thread counters threadCounts;
+static counters totalCounts;
+
+void flushCounters()
+{
+    __atomic_fetch_add(&totalCounts.words, threadCounts.words, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totalCounts.groups, threadCounts.groups, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totalCounts.probes, threadCounts.probes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totalCounts.compares, threadCounts.compares, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totalCounts.trieVisits, threadCounts.trieVisits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totalCounts.mallocs, threadCounts.mallocs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totalCounts.bytes, threadCounts.bytes, __ATOMIC_RELAXED);
+    memset(&threadCounts, 0, sizeof threadCounts);
+}
+
+/*
+ * words, keys and list nodes live until exit, so they are carved out of
+ * large blocks instead of one malloc each. Every thread has its own arena.
+ */
+typedef struct arena
+{
+    char *next;
+    size_t left;
+} arena;
+
+static __thread arena memArena;
+
+void *arenaAlloc(size_t size, size_t align)
+{
+    size_t pad = (align - (uintptr_t)memArena.next % align) % align;
+    if (memArena.next == NULL || size + pad > memArena.left)
+    {
+        size_t blockSize = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+        memArena.next = malloc(blockSize);
+        if (memArena.next == NULL)
+        {
+            memoryError();
+        }
+        memArena.left = blockSize;
+        pad = 0;
+        threadCounts.mallocs++;
+    }
+    threadCounts.bytes += size + pad;
+    void *p = memArena.next + pad;
+    memArena.next += size + pad;
+    memArena.left -= size + pad;
+    return p;
+}
+
+char *arenaCopy(const char *s)
+{
+    size_t size = strlen(s) + 1;
+    char *copy = arenaAlloc(size, 1);
+    memcpy(copy, s, size);
+    return copy;
+}
+
+/*
+ * block reader returning the same words as scanf("%64s")
+ */
+typedef struct wordReader
+{
+    FILE *fp;
+    size_t pos;
+    size_t len;
+    size_t size;
+    char buf[];
+} wordReader;
+
+wordReader *newReader(FILE *fp, size_t size)
+{
+    wordReader *r = malloc(sizeof(wordReader) + size);
+    if (r == NULL)
+    {
+        memoryError();
+    }
+    r->fp = fp;
+    r->pos = r->len = 0;
+    r->size = size;
+    return r;
+}
+
+int refill(wordReader *r)
 {
-    int w1Pos = 0, w2Pos = 0;
-    char w1Char = tolower(w1[w1Pos]);
-    char w2Char = tolower(w2[w2Pos]);
-    while (w1Char != '\0' || w2Char != '\0')
+    r->len = fread(r->buf, 1, r->size, r->fp);
+    r->pos = 0;
+    return r->len > 0;
+}
+
+int readWord(wordReader *r, char word[])
+{
+    while (1)
     {
-        if (w1Char == 'a' || w1Char == 'e' || w1Char == 'i' || w1Char == 'o' || w1Char == 'u')
+        if (r->pos == r->len && !refill(r))
         {
-            w1Pos++;
+            return 0;
         }
-        else if (w2Char == 'a' || w2Char == 'e' || w2Char == 'i' || w2Char == 'o' || w2Char == 'u')
+        if (!isspace((unsigned char)r->buf[r->pos]))
         {
-            w2Pos++;
+            break;
         }
-        else
+        r->pos++;
+    }
+    size_t len = 0;
+    while (len < 64)
+    {
+        if (r->pos == r->len && !refill(r))
         {
-            if (w1Char != '\0')
-            {
-                w1Pos++;
-            }
-            if (w2Char != '\0')
-            {
-                w2Pos++;
-            }
-            if (w1Char != w2Char)
+            break;
+        }
+        if (isspace((unsigned char)r->buf[r->pos]))
+        {
+            break;
+        }
+        word[len++] = r->buf[r->pos++];
+    }
+    threadCounts.words++;
+    word[len] = '\0';
+    return 1;
+}
+
+int isVowel(char c)
+{
+    return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u';
+}
+
+/*
+ * skeleton kernels: in one pass check that the word is alphabetic, lowercase
+ * it and drop the vowels into key. They return the key length, or -1 if the
+ * word has a non-letter. key needs KEY_SIZE bytes: the vector kernels store
+ * whole 8 byte groups past the end of the key.
+ */
+int skeletonScalar(const char word[], size_t len, char key[])
+{
+    size_t k = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = word[i];
+        if (!isalpha(c))
+        {
+            return -1;
+        }
+        c = tolower(c);
+        if (!isVowel(c))
+        {
+            key[k++] = c;
+        }
+    }
+    key[k] = '\0';
+    return (int)k;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/* compactTable[m] lists the positions of the set bits of m, then 0x80 (zero) */
+static unsigned char compactTable[256][8];
+
+void initCompactTable()
+{
+    for (int m = 0; m < 256; m++)
+    {
+        int k = 0;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            if (m & (1 << bit))
             {
-                return 0;
+                compactTable[m][k++] = (unsigned char)bit;
             }
         }
+        while (k < 8)
+        {
+            compactTable[m][k++] = 0x80;
+        }
+    }
+}
 
-        w1Char = tolower(w1[w1Pos]);
-        w2Char = tolower(w2[w2Pos]);
+/* packs the kept bytes of one 16 byte lane, 8 bytes at a time */
+__attribute__((target("ssse3")))
+static size_t compact16(__m128i lower, unsigned keep, char *out)
+{
+    uint64_t lo, hi;
+    memcpy(&lo, compactTable[keep & 0xff], 8);
+    memcpy(&hi, compactTable[keep >> 8], 8);
+    __m128i shuffle = _mm_add_epi8(_mm_set_epi64x((long long)hi, (long long)lo),
+                                   _mm_set_epi64x(0x0808080808080808LL, 0));
+    __m128i packed = _mm_shuffle_epi8(lower, shuffle);
+    size_t first = __builtin_popcount(keep & 0xff);
+    _mm_storel_epi64((__m128i *)out, packed);
+    _mm_storel_epi64((__m128i *)(out + first), _mm_srli_si128(packed, 8));
+    return first + __builtin_popcount(keep >> 8);
+}
+
+__attribute__((target("ssse3")))
+int skeletonSSE(const char word[], size_t len, char key[])
+{
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i bias = _mm_set1_epi8((char)(128 - 'a'));    // 'a' -> -128
+    const __m128i limit = _mm_set1_epi8((char)(-128 + 26));
+    size_t k = 0;
+    for (size_t i = 0; i < len; i += 16)
+    {
+        size_t n = len - i < 16 ? len - i : 16;
+        __m128i bytes;
+        if (n == 16)
+        {
+            bytes = _mm_loadu_si128((const __m128i *)(word + i));
+        }
+        else
+        {
+            char tail[16] = { 0 };
+            memcpy(tail, word + i, n);
+            bytes = _mm_loadu_si128((const __m128i *)tail);
+        }
+        unsigned lanes = (1u << n) - 1;
+        __m128i lower = _mm_or_si128(bytes, caseBit);
+        __m128i alpha = _mm_cmplt_epi8(_mm_add_epi8(lower, bias), limit);
+        if ((_mm_movemask_epi8(alpha) & lanes) != lanes)
+        {
+            return -1;
+        }
+        __m128i vowels = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('a')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('e'))),
+            _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('i')),
+                         _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('o')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('u')))));
+        unsigned keep = ~(unsigned)_mm_movemask_epi8(vowels) & lanes;
+        k += compact16(lower, keep, key + k);
     }
-    return 1;
+    key[k] = '\0';
+    return (int)k;
 }
 
-int legal(char word[])
+__attribute__((target("avx2")))
+int skeletonAVX2(const char word[], size_t len, char key[])
 {
-    int i = 0;
-    char c;
-    while ((c = word[i++]) != '\0')
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i bias = _mm256_set1_epi8((char)(128 - 'a'));
+    const __m256i limit = _mm256_set1_epi8((char)(-128 + 26));
+    size_t k = 0;
+    for (size_t i = 0; i < len; i += 32)
     {
-        if (!isalpha(c))
+        size_t n = len - i < 32 ? len - i : 32;
+        __m256i bytes;
+        if (n == 32)
         {
-            return 0;
+            bytes = _mm256_loadu_si256((const __m256i *)(word + i));
         }
+        else
+        {
+            char tail[32] = { 0 };
+            memcpy(tail, word + i, n);
+            bytes = _mm256_loadu_si256((const __m256i *)tail);
+        }
+        uint32_t lanes = n == 32 ? 0xffffffffu : (1u << n) - 1;
+        __m256i lower = _mm256_or_si256(bytes, caseBit);
+        __m256i alpha = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(lower, bias));
+        if (((uint32_t)_mm256_movemask_epi8(alpha) & lanes) != lanes)
+        {
+            return -1;
+        }
+        __m256i vowels = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('a')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('e'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('i')),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('o')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('u')))));
+        uint32_t keep = ~(uint32_t)_mm256_movemask_epi8(vowels) & lanes;
+        k += compact16(_mm256_castsi256_si128(lower), keep & 0xffff, key + k);
+        k += compact16(_mm256_extracti128_si256(lower, 1), keep >> 16, key + k);
     }
-    return 1;
+    key[k] = '\0';
+    return (int)k;
 }
 
-strNode *nextStrNode(char word[])
+#endif
+
+int (*skeletonKernel)(const char word[], size_t len, char key[]) = skeletonScalar;
+
+/* picks the widest kernel the CPU supports; NOVOWAL_KERNEL=scalar|sse|avx2 overrides */
+void initKernel()
 {
-    strNode *newNode = malloc(sizeof(strNode));
-    if (newNode == NULL)
+    const char *forced = getenv("NOVOWAL_KERNEL");
+#ifdef HAVE_X86_KERNELS
+    initCompactTable();
+    __builtin_cpu_init();
+    int sse = __builtin_cpu_supports("ssse3");
+    int avx2 = __builtin_cpu_supports("avx2");
+    if (forced != NULL)
     {
-        memoryError();
+        sse = sse && strcmp(forced, "sse") == 0;
+        avx2 = avx2 && strcmp(forced, "avx2") == 0;
     }
-    else
+    if (avx2)
     {
-        newNode->string = strdup(word);
-        newNode->next = NULL;
+        skeletonKernel = skeletonAVX2;
     }
-    return newNode;
+    else if (sse)
+    {
+        skeletonKernel = skeletonSSE;
+    }
+#else
+    (void)forced;
+#endif
 }
 
-node *nextNode(char word[])
+int skeleton(char word[], char key[])
+{
+    return skeletonKernel(word, strlen(word), key);
+}
+
+size_t hashKey(char key[])
 {
-    node *newNode = malloc(sizeof(node));
-    if (newNode == NULL)
+    size_t h = 2166136261u;
+    while (*key != '\0')
     {
-        memoryError();
+        h = (h ^ (unsigned char)*key++) * 16777619u;
     }
-    else
+    return h;
+}
+
+size_t findSlot(groupTable *table, char key[])
+{
+    size_t mask = table->capacity - 1;
+    size_t slot = hashKey(key) & mask;
+    threadCounts.probes++;
+    while (table->slots[slot] != NULL && (threadCounts.compares++, strcmp(table->slots[slot]->key, key) != 0))
+    {
+        slot = (slot + 1) & mask;
+        threadCounts.probes++;
+    }
+    return slot;
+}
+
+void insertGroup(groupTable *table, node *group)
+{
+    if (2 * (table->count + 1) > table->capacity)
     {
-        newNode->next = NULL;
-        newNode->str = nextStrNode(word);
+        size_t oldCapacity = table->capacity;
+        node **oldSlots = table->slots;
+        table->capacity = oldCapacity ? 2 * oldCapacity : 1024;
+        table->slots = calloc(table->capacity, sizeof(node *));
+        if (table->slots == NULL)
+        {
+            memoryError();
+        }
+        threadCounts.mallocs++;
+        for (size_t i = 0; i < oldCapacity; i++)
+        {
+            if (oldSlots[i] != NULL)
+            {
+                table->slots[findSlot(table, oldSlots[i]->key)] = oldSlots[i];
+            }
+        }
+        free(oldSlots);
     }
+    table->slots[findSlot(table, group->key)] = group;
+    table->count++;
+}
+
+/* word must already live in an arena, it is not copied */
+strNode *nextStrNode(char word[])
+{
+    strNode *newNode = arenaAlloc(sizeof(strNode), sizeof(void *));
+    newNode->string = word;
+    newNode->next = NULL;
+    return newNode;
+}
+
+node *nextNode(char word[])
+{
+    node *newNode = arenaAlloc(sizeof(node), sizeof(void *));
+    newNode->next = NULL;
+    newNode->key = NULL;
+    newNode->first = 0;
+    newNode->str = nextStrNode(word);
+    newNode->tail = newNode->str;
     return newNode;
 }
 
+void printGroup(node *group)
+{
+    strNode *strTmp = group->str;
+    while (strTmp != NULL)
+    {
+
+        printf("%s ", strTmp->string);
+        strTmp = strTmp->next;
+    }
+    printf("\n");
+}
+
 void print(node *head)
 {
     node *tmp = head;
     while (tmp != NULL)
     {
-        strNode *strTmp = tmp->str;
-        while (strTmp != NULL)
-        {
-
-            printf("%s ", strTmp->string);
-            strTmp = strTmp->next;
-        }
-        printf("\n");
+        printGroup(tmp);
         tmp = tmp->next;
     }
 }
 
-void addNode(strNode *sNode, char word[]) {
-    strNode *tmp = sNode;
-    while (tmp->next != NULL)
+void addNode(node *group, char word[]) {
+    group->tail->next = nextStrNode(word);
+    group->tail = group->tail->next;
+}
+
+
+void add(char word[], char key[], groupTable *table)
+{
+    node *group = table->slots[findSlot(table, key)];
+    if (group != NULL)
     {
-        tmp = tmp->next;
+        addNode(group, arenaCopy(word));
+        return;
     }
-    tmp->next = nextStrNode(word);
+
+    node *newNode = nextNode(arenaCopy(word));
+    newNode->key = arenaCopy(key);
+    table->last->next = newNode;
+    table->last = newNode;
+    insertGroup(table, newNode);
+    threadCounts.groups++;
 }
 
+/*
+ * parallel mode (-j N): the input is read whole and cut into N chunks at
+ * whitespace. Workers first tokenize their chunk and build keys, bucketing
+ * the word indexes by key hash into shards. Then each worker owns one shard
+ * and groups its words walking the chunks in input order, so every shard's
+ * group list is already in first-appearance order. The shard lists are
+ * merged by first sequence number, giving the same output as the serial run.
+ */
+typedef struct wordRec
+{
+    char *word;
+    char *key;    // NULL for a bad word
+    size_t hash;
+} wordRec;
 
-void add(char word[], node *head)
+typedef struct chunk
 {
-    node *tmp = head;
-    while (tmp->next != NULL)
+    const char *begin;
+    const char *end;
+    wordRec *words;
+    size_t count;
+    size_t capacity;
+    size_t **shardWords;    // indexes into words, per shard
+    size_t *shardCount;
+    size_t *shardCapacity;
+} chunk;
+
+typedef struct worker
+{
+    pthread_t thread;
+    int id;
+    int numThreads;
+    chunk *chunks;
+    node head;    // dummy head of this shard's group list
+    groupTable table;
+} worker;
+
+void pushIndex(size_t **list, size_t *count, size_t *capacity, size_t value)
+{
+    if (*count == *capacity)
     {
-        if (isNoVowelEqual(word, tmp->str->string))
+        *capacity = *capacity ? 2 * *capacity : 256;
+        *list = realloc(*list, *capacity * sizeof(size_t));
+        if (*list == NULL)
         {
-            addNode(tmp->str, word);
-            return;
+            memoryError();
         }
-        tmp = tmp->next;
+        threadCounts.mallocs++;
     }
-    if (isNoVowelEqual(word, tmp->str->string))
+    (*list)[(*count)++] = value;
+}
+
+void *tokenizeChunk(void *arg)
+{
+    worker *w = arg;
+    chunk *c = &w->chunks[w->id];
+    const char *p = c->begin;
+    char input[65];
+    char key[KEY_SIZE];
+    c->shardWords = calloc(w->numThreads, sizeof(size_t *));
+    c->shardCount = calloc(w->numThreads, sizeof(size_t));
+    c->shardCapacity = calloc(w->numThreads, sizeof(size_t));
+    if (c->shardWords == NULL || c->shardCount == NULL || c->shardCapacity == NULL)
     {
-        addNode(tmp->str, word);
-        return;
+        memoryError();
     }
-    else
+    while (1)
     {
-        node *newNode = malloc(sizeof(node));
-        if (newNode == NULL)
+        // same tokens as scanf("%64s"): skip blanks, take at most 64 others
+        while (p < c->end && isspace((unsigned char)*p))
         {
-            memoryError();
+            p++;
         }
-        else
+        if (p == c->end)
+        {
+            break;
+        }
+        size_t len = 0;
+        while (p < c->end && len < 64 && !isspace((unsigned char)*p))
         {
-            newNode->str = nextStrNode(word);
-            newNode->next = NULL;
-            tmp->next = newNode;
+            input[len++] = *p++;
         }
+        input[len] = '\0';
+
+        if (c->count == c->capacity)
+        {
+            c->capacity = c->capacity ? 2 * c->capacity : 1024;
+            c->words = realloc(c->words, c->capacity * sizeof(wordRec));
+            if (c->words == NULL)
+            {
+                memoryError();
+            }
+            threadCounts.mallocs++;
+        }
+        wordRec *rec = &c->words[c->count];
+        int keyLen = skeletonKernel(input, strlen(input), key);
+        rec->word = arenaAlloc(len + 1 + (keyLen < 0 ? 0 : keyLen + 1), 1);
+        strcpy(rec->word, input);
+        rec->key = NULL;
+        if (keyLen >= 0)
+        {
+            rec->key = rec->word + len + 1;
+            strcpy(rec->key, key);
+            rec->hash = hashKey(key);
+            int shard = rec->hash % w->numThreads;
+            pushIndex(&c->shardWords[shard], &c->shardCount[shard], &c->shardCapacity[shard], c->count);
+        }
+        c->count++;
     }
+    threadCounts.words += c->count;
+    flushCounters();
+    return NULL;
 }
 
-int main()
+void *groupShard(void *arg)
 {
-    int invalidWords = 0;
-    node *head = malloc(sizeof(node));
-    if (head == NULL)
+    worker *w = arg;
+    for (int i = 0; i < w->numThreads; i++)
+    {
+        chunk *c = &w->chunks[i];
+        for (size_t j = 0; j < c->shardCount[w->id]; j++)
+        {
+            size_t index = c->shardWords[w->id][j];
+            wordRec *rec = &c->words[index];
+            node *group = w->table.slots[findSlot(&w->table, rec->key)];
+            if (group != NULL)
+            {
+                addNode(group, rec->word);
+                continue;
+            }
+            group = nextNode(rec->word);
+            group->key = rec->key;
+            group->first = ((unsigned long)i << 40) | index;
+            w->table.last->next = group;
+            w->table.last = group;
+            insertGroup(&w->table, group);
+            threadCounts.groups += rec->key[0] != '\0';
+        }
+    }
+    flushCounters();
+    return NULL;
+}
+
+/* maps the input when it is a regular file, reads it in blocks otherwise */
+char *readAll(FILE *fp, size_t *size)
+{
+    struct stat info;
+    if (fstat(fileno(fp), &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        char *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+        if (data != MAP_FAILED)
+        {
+            *size = info.st_size;
+            return data;
+        }
+    }
+    size_t capacity = 1 << 20;
+    char *data = malloc(capacity);
+    *size = 0;
+    size_t got;
+    while (data != NULL && (got = fread(data + *size, 1, capacity - *size, fp)) > 0)
+    {
+        *size += got;
+        if (*size == capacity)
+        {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    if (data == NULL)
+    {
+        memoryError();
+    }
+    return data;
+}
+
+void runWorkers(worker *workers, int numThreads, void *(*job)(void *))
+{
+    for (int i = 1; i < numThreads; i++)
+    {
+        if (pthread_create(&workers[i].thread, NULL, job, &workers[i]) != 0)
+        {
+            fprintf(stderr, "ERROR: Cannot start thread\n");
+            exit(1);
+        }
+    }
+    job(&workers[0]);
+    for (int i = 1; i < numThreads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+}
+
+node *groupParallel(int numThreads, int *invalidWords)
+{
+    size_t size;
+    char *data = readAll(stdin, &size);
+    chunk *chunks = calloc(numThreads, sizeof(chunk));
+    worker *workers = calloc(numThreads, sizeof(worker));
+    if (chunks == NULL || workers == NULL)
     {
         memoryError();
     }
-    head->str = malloc(sizeof(strNode));
-    if (head->str == NULL)
+
+    // chunk boundaries move forward to the next blank so no word is cut
+    const char *p = data, *end = data + size;
+    for (int i = 0; i < numThreads; i++)
+    {
+        const char *stop = data + size * (i + 1) / numThreads;
+        if (stop < p)
+        {
+            stop = p;
+        }
+        while (stop < end && !isspace((unsigned char)*stop))
+        {
+            stop++;
+        }
+        chunks[i].begin = p;
+        chunks[i].end = stop;
+        p = stop;
+    }
+    for (int i = 0; i < numThreads; i++)
+    {
+        workers[i].id = i;
+        workers[i].numThreads = numThreads;
+        workers[i].chunks = chunks;
+        workers[i].table.last = &workers[i].head;
+        workers[i].table.capacity = 1024;
+        workers[i].table.slots = calloc(1024, sizeof(node *));
+        if (workers[i].table.slots == NULL)
+        {
+            memoryError();
+        }
+    }
+
+    runWorkers(workers, numThreads, tokenizeChunk);
+
+    *invalidWords = 0;
+    for (int i = 0; i < numThreads; i++)
+    {
+        for (size_t j = 0; j < chunks[i].count; j++)
+        {
+            if (chunks[i].words[j].key == NULL)
+            {
+                fprintf(stderr, "Bad word: %s \n", chunks[i].words[j].word);
+                (*invalidWords)++;
+            }
+        }
+    }
+
+    runWorkers(workers, numThreads, groupShard);
+
+    // merge the shard lists by first appearance; the empty key is never printed
+    node merged = { 0 };
+    node *last = &merged;
+    node **cursor = malloc(numThreads * sizeof(node *));
+    if (cursor == NULL)
     {
         memoryError();
     }
-    head->str = nextStrNode("");
-    //test
-    head->str->next = NULL;
-    head->next = NULL;
+    for (int i = 0; i < numThreads; i++)
+    {
+        cursor[i] = workers[i].head.next;
+    }
+    while (1)
+    {
+        int best = -1;
+        for (int i = 0; i < numThreads; i++)
+        {
+            if (cursor[i] != NULL && (best == -1 || cursor[i]->first < cursor[best]->first))
+            {
+                best = i;
+            }
+        }
+        if (best == -1)
+        {
+            break;
+        }
+        node *group = cursor[best];
+        cursor[best] = group->next;
+        if (group->key[0] != '\0')
+        {
+            last->next = group;
+            last = group;
+        }
+    }
+    last->next = NULL;
+    free(cursor);
+    return merged.next;
+}
+
+node *groupSerial(int *invalidWords)
+{
+    *invalidWords = 0;
+    node *head = nextNode(arenaCopy(""));
+    // words without consonants share the empty key with head, which is never printed
+    head->key = "";
+    groupTable table = { NULL, 0, 0, head };
+    insertGroup(&table, head);
     //-------------------------
-    char input[64];
-    while (scanf("%64s", input) != EOF)
+    char input[65];
+    char key[KEY_SIZE];
+    wordReader *reader = newReader(stdin, READ_BLOCK);
+    while (readWord(reader, input))
     {
-        if (legal(input))
+        if (skeleton(input, key) != -1)
         {
-            add(input, head);
+            add(input, key, &table);
         }
         else
         {
             fprintf(stderr, "Bad word: %s \n", input);
-            invalidWords++;
+            (*invalidWords)++;
         }
     }
-    if (head->next != NULL)
-    {
-        print(head->next);
-    }
-    return invalidWords;
+    free(reader);
+    return head->next;
 }
 
+/*
+ * out-of-core mode (-m budgetMB [-T tmpdir]): nothing is kept per word.
+ * Words become (key, position, word) records that are sorted in a buffer
+ * of about half the budget and spilled to temporary runs. Merging the runs
+ * by key gives every group's first position, the words are re-sorted by
+ * (first position, position) the same way, and the final merge prints the
+ * groups in the order print() would. The live buffers (input, one sort
+ * buffer with its pointers and the buffers of the runs being merged) stay
+ * within the budget. Runs waiting to be merged are kept as bare
+ * descriptors, and as soon as fanIn runs of one level exist they are
+ * merged into one run of the next level, so only a few runs per level are
+ * open at once and their number never exceeds the descriptor limit.
+ */
+#define MERGE_FANIN 64
+#define MERGE_BUFFER (16 << 10)
+#define RESERVED_FILES 8        // stdin, stdout, stderr and a few to spare
+
+typedef struct extRec
+{
+    uint64_t major;         // 0 while sorting by key, the group's first position after
+    uint64_t seq;           // input position of the word
+    unsigned char keyLen;
+    unsigned char wordLen;
+    char data[2 * KEY_SIZE]; // key then word, the word NUL terminated in memory only
+} extRec;
+
+typedef struct runFile
+{
+    int fd;                 // bare descriptor, so a waiting run holds no stdio buffer
+    unsigned level;         // merge passes behind the run, 0 for a spilled buffer
+} runFile;
+
+typedef struct runSet
+{
+    char *buf;
+    size_t used;
+    size_t bufSize;
+    extRec **recs;
+    size_t count;
+    size_t maxRecs;
+    runFile *runs;          // oldest first, which cascading keeps in falling level order
+    size_t numRuns;
+    size_t runCapacity;
+    size_t maxRuns;         // waiting runs allowed before the newest are merged anyway
+    const char *tmpDir;
+    size_t fanIn;
+    size_t readBuffer;
+} runSet;
+
+typedef struct runCursor
+{
+    runSet *set;
+    size_t next;            // in-memory position when nothing was spilled
+    extRec **heap;          // current record of each run, smallest first
+    FILE **files;           // heap[i] was read from files[i]
+    size_t size;
+    extRec current;
+} runCursor;
+
+size_t recordSize(const extRec *r)
+{
+    return offsetof(extRec, data) + r->keyLen + r->wordLen;
+}
+
+int compareRecords(const extRec *a, const extRec *b)
+{
+    threadCounts.compares++;
+    if (a->major != b->major)
+    {
+        return a->major < b->major ? -1 : 1;
+    }
+    size_t len = a->keyLen < b->keyLen ? a->keyLen : b->keyLen;
+    int cmp = memcmp(a->data, b->data, len);
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+    if (a->keyLen != b->keyLen)
+    {
+        return a->keyLen < b->keyLen ? -1 : 1;
+    }
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+int compareRecordPtrs(const void *a, const void *b)
+{
+    return compareRecords(*(extRec * const *)a, *(extRec * const *)b);
+}
+
+/* reports the call that failed on a temporary run and its errno */
+void tempError(const char *call, const char *dir)
+{
+    fprintf(stderr, "ERROR: %s failed on a temporary run in %s: %s\n", call, dir, strerror(errno));
+    exit(1);
+}
+
+FILE *tempRun(runSet *set)
+{
+    size_t len = strlen(set->tmpDir) + sizeof "/noVowal.XXXXXX";
+    char *path = malloc(len);
+    if (path == NULL)
+    {
+        memoryError();
+    }
+    snprintf(path, len, "%s/noVowal.XXXXXX", set->tmpDir);
+    int fd = mkstemp(path);
+    if (fd == -1)
+    {
+        tempError("mkstemp", set->tmpDir);
+    }
+    // the run is only reachable through the open descriptor from here on
+    unlink(path);
+    free(path);
+    FILE *fp = fdopen(fd, "w+b");
+    if (fp == NULL)
+    {
+        tempError("fdopen", set->tmpDir);
+    }
+    return fp;
+}
+
+void initRunSet(runSet *set, size_t budget, const char *tmpDir)
+{
+    // half the budget sorts records, an eighth holds their pointers and
+    // another eighth buffers the runs being merged
+    set->bufSize = budget / 2;
+    set->maxRecs = set->bufSize / 32;
+    set->buf = malloc(set->bufSize);
+    set->recs = malloc(set->maxRecs * sizeof(extRec *));
+    if (set->buf == NULL || set->recs == NULL)
+    {
+        memoryError();
+    }
+    threadCounts.mallocs += 2;
+    set->used = set->count = 0;
+    set->runs = NULL;
+    set->numRuns = set->runCapacity = 0;
+    set->tmpDir = tmpDir;
+    set->fanIn = budget / 8 / MERGE_BUFFER;
+    set->fanIn = set->fanIn < 2 ? 2 : set->fanIn > MERGE_FANIN ? MERGE_FANIN : set->fanIn;
+
+    // two sets hold runs at once while the key merge feeds the second
+    // sort, so each gets half of the spare descriptors. A merge opens one
+    // more for the run it writes.
+    struct rlimit limit;
+    size_t files = MERGE_FANIN * MERGE_FANIN;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < files)
+    {
+        files = limit.rlim_cur;
+    }
+    files = files > RESERVED_FILES ? (files - RESERVED_FILES) / 2 : 0;
+    if (files < 3)
+    {
+        fprintf(stderr, "ERROR: Too few file descriptors for -m\n");
+        exit(1);
+    }
+    set->maxRuns = files - 1;
+    if (set->fanIn > set->maxRuns)
+    {
+        set->fanIn = set->maxRuns;
+    }
+    set->readBuffer = budget / 8 / set->fanIn;
+}
+
+/* keeps the finished run fp as a bare descriptor until it is merged */
+void pushRun(runSet *set, FILE *fp, unsigned level)
+{
+    if (set->numRuns == set->runCapacity)
+    {
+        set->runCapacity = set->runCapacity ? set->runCapacity * 2 : 16;
+        set->runs = realloc(set->runs, set->runCapacity * sizeof(runFile));
+        if (set->runs == NULL)
+        {
+            memoryError();
+        }
+        threadCounts.mallocs++;
+    }
+    if (fflush(fp) != 0)
+    {
+        tempError("write", set->tmpDir);
+    }
+    int fd = dup(fileno(fp));
+    if (fd == -1)
+    {
+        tempError("dup", set->tmpDir);
+    }
+    if (fclose(fp) != 0)
+    {
+        tempError("close", set->tmpDir);
+    }
+    set->runs[set->numRuns].fd = fd;
+    set->runs[set->numRuns++].level = level;
+}
+
+void writeRecord(runSet *set, FILE *fp, const extRec *r)
+{
+    if (fwrite(r, recordSize(r), 1, fp) != 1)
+    {
+        tempError("write", set->tmpDir);
+    }
+}
+
+int readRecord(runSet *set, FILE *fp, extRec *r)
+{
+    size_t head = offsetof(extRec, data);
+    if (fread(r, head, 1, fp) != 1)
+    {
+        if (ferror(fp))
+        {
+            tempError("read", set->tmpDir);
+        }
+        return 0;
+    }
+    if (fread(r->data, r->keyLen + r->wordLen, 1, fp) != 1)
+    {
+        // a run cut short is as broken as one that cannot be read
+        if (!ferror(fp))
+        {
+            errno = EIO;
+        }
+        tempError("read", set->tmpDir);
+    }
+    r->data[r->keyLen + r->wordLen] = '\0';
+    return 1;
+}
+
+void siftDown(runCursor *c, size_t i)
+{
+    while (1)
+    {
+        size_t least = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < c->size && compareRecords(c->heap[l], c->heap[least]) < 0)
+        {
+            least = l;
+        }
+        if (r < c->size && compareRecords(c->heap[r], c->heap[least]) < 0)
+        {
+            least = r;
+        }
+        if (least == i)
+        {
+            return;
+        }
+        extRec *rec = c->heap[i];
+        c->heap[i] = c->heap[least];
+        c->heap[least] = rec;
+        FILE *fp = c->files[i];
+        c->files[i] = c->files[least];
+        c->files[least] = fp;
+        i = least;
+    }
+}
+
+void openMerge(runCursor *c, runSet *set, runFile *runs, size_t n)
+{
+    c->set = set;
+    c->next = 0;
+    c->size = 0;
+    c->heap = malloc(n * sizeof(extRec *));
+    c->files = malloc(n * sizeof(FILE *));
+    if (c->heap == NULL || c->files == NULL)
+    {
+        memoryError();
+    }
+    threadCounts.mallocs += 2 + n;
+    for (size_t i = 0; i < n; i++)
+    {
+        extRec *rec = malloc(sizeof(extRec));
+        if (rec == NULL)
+        {
+            memoryError();
+        }
+        if (lseek(runs[i].fd, 0, SEEK_SET) != 0)
+        {
+            tempError("lseek", set->tmpDir);
+        }
+        FILE *fp = fdopen(runs[i].fd, "rb");
+        if (fp == NULL)
+        {
+            tempError("fdopen", set->tmpDir);
+        }
+        setvbuf(fp, NULL, _IOFBF, set->readBuffer);
+        if (readRecord(set, fp, rec))
+        {
+            c->heap[c->size] = rec;
+            c->files[c->size++] = fp;
+        }
+        else
+        {
+            free(rec);
+            fclose(fp);
+        }
+    }
+    for (size_t i = c->size / 2; i-- > 0;)
+    {
+        siftDown(c, i);
+    }
+}
+
+/*
+ * returns the next record in sorted order, valid until the next call,
+ * or NULL once every record was returned
+ */
+const extRec *nextRecord(runCursor *c)
+{
+    if (c->heap == NULL)
+    {
+        return c->next < c->set->count ? c->set->recs[c->next++] : NULL;
+    }
+    if (c->size == 0)
+    {
+        return NULL;
+    }
+    extRec *top = c->heap[0];
+    memcpy(&c->current, top, recordSize(top) + 1);
+    if (!readRecord(c->set, c->files[0], top))
+    {
+        fclose(c->files[0]);
+        free(top);
+        c->size--;
+        c->heap[0] = c->heap[c->size];
+        c->files[0] = c->files[c->size];
+    }
+    siftDown(c, 0);
+    return &c->current;
+}
+
+void closeMerge(runCursor *c)
+{
+    for (size_t i = 0; i < c->size; i++)
+    {
+        free(c->heap[i]);
+        fclose(c->files[i]);
+    }
+    free(c->heap);
+    free(c->files);
+}
+
+/*
+ * merges the newest n runs into one run a level above the oldest of them
+ */
+void mergeNewest(runSet *set, size_t n)
+{
+    size_t first = set->numRuns - n;
+    unsigned level = set->runs[first].level + 1;
+    runCursor pass;
+    openMerge(&pass, set, set->runs + first, n);
+    set->numRuns = first;
+    FILE *fp = tempRun(set);
+    const extRec *r;
+    while ((r = nextRecord(&pass)) != NULL)
+    {
+        writeRecord(set, fp, r);
+    }
+    closeMerge(&pass);
+    pushRun(set, fp, level);
+}
+
+/*
+ * merges waiting runs after a spill: fanIn runs of one level become a run
+ * of the next, which can cascade, and if maxRuns are still waiting the
+ * newest fanIn are merged whatever their levels
+ */
+void settleRuns(runSet *set)
+{
+    while (set->numRuns >= set->fanIn &&
+           set->runs[set->numRuns - set->fanIn].level == set->runs[set->numRuns - 1].level)
+    {
+        mergeNewest(set, set->fanIn);
+    }
+    if (set->numRuns >= set->maxRuns)
+    {
+        mergeNewest(set, set->fanIn);
+    }
+}
+
+void spillRun(runSet *set)
+{
+    qsort(set->recs, set->count, sizeof(extRec *), compareRecordPtrs);
+    FILE *fp = tempRun(set);
+    for (size_t i = 0; i < set->count; i++)
+    {
+        writeRecord(set, fp, set->recs[i]);
+    }
+    pushRun(set, fp, 0);
+    set->used = set->count = 0;
+    settleRuns(set);
+}
+
+void addRecord(runSet *set, uint64_t major, uint64_t seq, const char *key, size_t keyLen, const char *word)
+{
+    size_t wordLen = strlen(word);
+    size_t size = (offsetof(extRec, data) + keyLen + wordLen + 1 + 7) & ~(size_t)7;
+    if (set->used + size > set->bufSize || set->count == set->maxRecs)
+    {
+        spillRun(set);
+    }
+    extRec *r = (extRec *)(set->buf + set->used);
+    r->major = major;
+    r->seq = seq;
+    r->keyLen = keyLen;
+    r->wordLen = wordLen;
+    memcpy(r->data, key, keyLen);
+    memcpy(r->data + keyLen, word, wordLen + 1);
+    set->recs[set->count++] = r;
+    set->used += size;
+}
+
+/*
+ * finishes adding records and opens a cursor over all of them. The newest
+ * runs are merged until at most fanIn are left for the last pass.
+ */
+void openRuns(runCursor *c, runSet *set)
+{
+    c->heap = NULL;
+    c->files = NULL;
+    c->set = set;
+    c->next = 0;
+    c->size = 0;
+    if (set->numRuns == 0)
+    {
+        qsort(set->recs, set->count, sizeof(extRec *), compareRecordPtrs);
+        return;
+    }
+    if (set->count > 0)
+    {
+        spillRun(set);
+    }
+    // the sort buffer is not needed again, the merge buffers take its place
+    free(set->buf);
+    free(set->recs);
+    set->buf = NULL;
+    set->recs = NULL;
+    while (set->numRuns > set->fanIn)
+    {
+        size_t excess = set->numRuns - set->fanIn + 1;
+        mergeNewest(set, excess < set->fanIn ? excess : set->fanIn);
+    }
+    openMerge(c, set, set->runs, set->numRuns);
+}
+
+void freeRunSet(runSet *set)
+{
+    free(set->buf);
+    free(set->recs);
+    free(set->runs);
+}
+
+/*
+ * true if r starts a new group in key order: its key differs from the
+ * previous one, which key[] and *keyLen hold and which r's key replaces
+ */
+int nextGroup(const extRec *r, char key[], size_t *keyLen)
+{
+    if (r->keyLen == *keyLen && memcmp(r->data, key, *keyLen) == 0)
+    {
+        return 0;
+    }
+    threadCounts.groups++;
+    *keyLen = r->keyLen;
+    memcpy(key, r->data, r->keyLen);
+    return 1;
+}
+
+int groupExternal(size_t budget, const char *tmpDir)
+{
+    int invalidWords = 0;
+    char input[65];
+    char key[KEY_SIZE];
+    // an eighth of the budget reads, the sort buffer takes five more and
+    // merging spilled runs one
+    wordReader *reader = newReader(stdin, budget / 8);
+
+    runSet byKey;
+    initRunSet(&byKey, budget, tmpDir);
+    uint64_t seq = 0;
+    while (readWord(reader, input))
+    {
+        int keyLen = skeleton(input, key);
+        if (keyLen == -1)
+        {
+            fprintf(stderr, "Bad word: %s \n", input);
+            invalidWords++;
+        }
+        else if (keyLen > 0)
+        {
+            // words without consonants are never printed
+            addRecord(&byKey, 0, seq, key, keyLen, input);
+        }
+        seq++;
+    }
+    free(reader);
+
+    runSet byFirst;
+    const extRec *r;
+    uint64_t first = 0;
+    size_t lastLen = 0;
+    if (byKey.numRuns == 0)
+    {
+        // everything fit: the records get their group's first position in
+        // place and the same buffer is sorted again, so only one is live.
+        // Records of one group share their key, which keeps them in
+        // position order when sorted by (first, key, position).
+        qsort(byKey.recs, byKey.count, sizeof(extRec *), compareRecordPtrs);
+        for (size_t i = 0; i < byKey.count; i++)
+        {
+            extRec *rec = byKey.recs[i];
+            if (nextGroup(rec, key, &lastLen))
+            {
+                first = rec->seq;
+            }
+            rec->major = first;
+        }
+        byFirst = byKey;
+    }
+    else
+    {
+        // the sort buffer of byKey is freed before byFirst gets its own
+        runCursor keys;
+        openRuns(&keys, &byKey);
+        initRunSet(&byFirst, budget, tmpDir);
+        while ((r = nextRecord(&keys)) != NULL)
+        {
+            if (nextGroup(r, key, &lastLen))
+            {
+                first = r->seq;
+            }
+            addRecord(&byFirst, first, r->seq, "", 0, r->data + r->keyLen);
+        }
+        closeMerge(&keys);
+        freeRunSet(&byKey);
+    }
+
+    runCursor groups;
+    openRuns(&groups, &byFirst);
+    int printed = 0;
+    while ((r = nextRecord(&groups)) != NULL)
+    {
+        if (printed && r->major != first)
+        {
+            printf("\n");
+        }
+        first = r->major;
+        printed = 1;
+        printf("%s ", r->data + r->keyLen);
+    }
+    if (printed)
+    {
+        printf("\n");
+    }
+    closeMerge(&groups);
+    freeRunSet(&byFirst);
+    return invalidWords;
+}
+
+/*
+ * approximate mode (-a D): after the exact groups, every group whose
+ * skeleton is within edit distance D of other skeletons gets a line
+ *   key ~ neighbor neighbor ...
+ * The keys are kept in a trie and each lookup walks it with one row of the
+ * Levenshtein table per trie level, leaving a branch as soon as every entry
+ * of its row is over D. Once built, the trie is laid out breadth first so
+ * the children of a node sit next to each other.
+ */
+typedef struct trieNode
+{
+    char c;
+    struct trieNode *child;     // children are kept sorted by c
+    struct trieNode *sibling;
+    node *group;                // group whose key ends here, or NULL
+} trieNode;
+
+typedef struct flatNode
+{
+    char c;
+    unsigned char numChildren;
+    uint32_t firstChild;
+    node *group;
+} flatNode;
+
+size_t trieInsert(trieNode *root, node *group)
+{
+    size_t added = 0;
+    trieNode *t = root;
+    for (const char *k = group->key; *k != '\0'; k++)
+    {
+        trieNode **link = &t->child;
+        while (*link != NULL && (*link)->c < *k)
+        {
+            link = &(*link)->sibling;
+        }
+        if (*link == NULL || (*link)->c != *k)
+        {
+            trieNode *newNode = arenaAlloc(sizeof(trieNode), sizeof(void *));
+            newNode->c = *k;
+            newNode->child = NULL;
+            newNode->group = NULL;
+            newNode->sibling = *link;
+            *link = newNode;
+            added++;
+        }
+        t = *link;
+    }
+    t->group = group;
+    return added;
+}
+
+/* node 0 is the root, a node's children follow each other in key order */
+flatNode *flattenTrie(trieNode *root, size_t size)
+{
+    flatNode *flat = malloc(size * sizeof(flatNode));
+    trieNode **queue = malloc(size * sizeof(trieNode *));
+    if (flat == NULL || queue == NULL)
+    {
+        memoryError();
+    }
+    size_t tail = 0;
+    queue[tail++] = root;
+    for (size_t i = 0; i < tail; i++)
+    {
+        flat[i].c = queue[i]->c;
+        flat[i].group = queue[i]->group;
+        flat[i].firstChild = tail;
+        flat[i].numChildren = 0;
+        for (trieNode *child = queue[i]->child; child != NULL; child = child->sibling)
+        {
+            queue[tail++] = child;
+            flat[i].numChildren++;
+        }
+    }
+    free(queue);
+    return flat;
+}
+
+typedef struct nearSearch
+{
+    const flatNode *trie;
+    const char *key;
+    size_t keyLen;
+    int maxDist;
+    node *self;
+    size_t found;
+    unsigned char rows[KEY_SIZE][KEY_SIZE];     // row d is the table row for trie depth d
+} nearSearch;
+
+void nearKeys(nearSearch *search, const flatNode *t, size_t depth)
+{
+    const unsigned char *prev = search->rows[depth];
+    unsigned char *row = search->rows[depth + 1];
+    // only cells within maxDist of the diagonal can stay within maxDist, the rest read as maxDist + 1
+    unsigned char over = search->maxDist + 1;
+    size_t d = depth + 1;
+    size_t lo = d > (size_t)search->maxDist ? d - search->maxDist : 1;
+    size_t hi = d + search->maxDist < search->keyLen ? d + search->maxDist : search->keyLen;
+    const flatNode *child = search->trie + t->firstChild;
+    for (const flatNode *end = child + t->numChildren; child < end; child++)
+    {
+        threadCounts.trieVisits++;
+        row[0] = d < over ? d : over;
+        row[lo - 1] = lo > 1 ? over : row[0];
+        unsigned char least = lo > 1 ? over : row[0];
+        for (size_t j = lo; j <= hi; j++)
+        {
+            unsigned char cost = prev[j - 1] + (search->key[j - 1] != child->c);
+            unsigned char insert = row[j - 1] + 1, remove = prev[j] + 1;
+            cost = cost < insert ? cost : insert;
+            cost = cost < remove ? cost : remove;
+            row[j] = cost < over ? cost : over;
+            least = row[j] < least ? row[j] : least;
+        }
+        if (hi < search->keyLen)
+        {
+            row[hi + 1] = over;
+        }
+        if (child->group != NULL && child->group != search->self &&
+            search->keyLen <= hi && row[search->keyLen] <= search->maxDist)
+        {
+            if (search->found++ == 0)
+            {
+                printf("%s ~ ", search->key);
+            }
+            printf("%s ", child->group->key);
+        }
+        if (least <= search->maxDist && child->numChildren > 0)
+        {
+            nearKeys(search, child, depth + 1);
+        }
+    }
+}
+
+void printApproximate(node *groups, int maxDist)
+{
+    trieNode root = { 0, NULL, NULL, NULL };
+    size_t size = 1;
+    for (node *group = groups; group != NULL; group = group->next)
+    {
+        size += trieInsert(&root, group);
+    }
+    nearSearch *search = malloc(sizeof(nearSearch));
+    if (search == NULL)
+    {
+        memoryError();
+    }
+    search->trie = flattenTrie(&root, size);
+    search->maxDist = maxDist;
+    for (node *group = groups; group != NULL; group = group->next)
+    {
+        search->key = group->key;
+        search->keyLen = strlen(group->key);
+        search->self = group;
+        for (size_t j = 0; j <= search->keyLen; j++)
+        {
+            search->rows[0][j] = j <= (size_t)maxDist ? j : (size_t)maxDist + 1;
+        }
+        search->found = 0;
+        nearKeys(search, search->trie, 0);
+        if (search->found > 0)
+        {
+            printf("\n");
+        }
+    }
+    free((void *)search->trie);
+    free(search);
+}
+
+/*
+ * skeleton index (-b to build, -q to query). The file is laid out so it
+ * can be used straight from a read-only mapping:
+ *   indexHeader
+ *   indexGroup[numGroups]      sorted by key
+ *   uint64_t wordAt[numWords]  offset of each word in the word blob,
+ *                              a group's words are contiguous, in input order
+ *   key blob, word blob        NUL terminated strings
+ */
+#define INDEX_MAGIC "NOVOWIDX"
+#define INDEX_VERSION 1
+
+typedef struct indexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t numGroups;
+    uint64_t numWords;
+    uint64_t keysSize;
+    uint64_t wordsSize;
+} indexHeader;
+
+typedef struct indexGroup
+{
+    uint64_t keyAt;
+    uint64_t firstWord;
+    uint64_t numWords;
+} indexGroup;
+
+int compareGroupKeys(const void *a, const void *b)
+{
+    threadCounts.compares++;
+    return strcmp((*(node * const *)a)->key, (*(node * const *)b)->key);
+}
+
+int writeIndex(node *groups, const char *path)
+{
+    size_t numGroups = 0, numWords = 0, keysSize = 0, wordsSize = 0;
+    for (node *group = groups; group != NULL; group = group->next)
+    {
+        numGroups++;
+        keysSize += strlen(group->key) + 1;
+        for (strNode *s = group->str; s != NULL; s = s->next)
+        {
+            numWords++;
+            wordsSize += strlen(s->string) + 1;
+        }
+    }
+    node **sorted = malloc((numGroups ? numGroups : 1) * sizeof(node *));
+    if (sorted == NULL)
+    {
+        memoryError();
+    }
+    size_t i = 0;
+    for (node *group = groups; group != NULL; group = group->next)
+    {
+        sorted[i++] = group;
+    }
+    qsort(sorted, numGroups, sizeof(node *), compareGroupKeys);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot write index %s\n", path);
+        free(sorted);
+        return -1;
+    }
+    indexHeader header = { INDEX_MAGIC, INDEX_VERSION, 0, numGroups, numWords, keysSize, wordsSize };
+    int failed = fwrite(&header, sizeof header, 1, fp) != 1;
+
+    uint64_t keyAt = 0, wordIndex = 0;
+    for (i = 0; i < numGroups && !failed; i++)
+    {
+        indexGroup entry = { keyAt, wordIndex, 0 };
+        for (strNode *s = sorted[i]->str; s != NULL; s = s->next)
+        {
+            entry.numWords++;
+        }
+        keyAt += strlen(sorted[i]->key) + 1;
+        wordIndex += entry.numWords;
+        failed = fwrite(&entry, sizeof entry, 1, fp) != 1;
+    }
+    uint64_t wordAt = 0;
+    for (i = 0; i < numGroups && !failed; i++)
+    {
+        for (strNode *s = sorted[i]->str; s != NULL && !failed; s = s->next)
+        {
+            failed = fwrite(&wordAt, sizeof wordAt, 1, fp) != 1;
+            wordAt += strlen(s->string) + 1;
+        }
+    }
+    for (i = 0; i < numGroups && !failed; i++)
+    {
+        failed = fwrite(sorted[i]->key, strlen(sorted[i]->key) + 1, 1, fp) != 1;
+    }
+    for (i = 0; i < numGroups && !failed; i++)
+    {
+        for (strNode *s = sorted[i]->str; s != NULL && !failed; s = s->next)
+        {
+            failed = fwrite(s->string, strlen(s->string) + 1, 1, fp) != 1;
+        }
+    }
+    free(sorted);
+    if (fclose(fp) != 0 || failed)
+    {
+        fprintf(stderr, "ERROR: Cannot write index %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * answers one line per input word: the indexed words with the same
+ * skeleton, or an empty line if there are none
+ */
+int queryIndex(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(indexHeader))
+    {
+        fprintf(stderr, "ERROR: Cannot read index %s\n", path);
+        exit(1);
+    }
+    const char *base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: Cannot read index %s\n", path);
+        exit(1);
+    }
+    indexHeader header;
+    memcpy(&header, base, sizeof header);
+    uint64_t size = info.st_size;
+    int valid = memcmp(header.magic, INDEX_MAGIC, 8) == 0 && header.version == INDEX_VERSION &&
+                header.numGroups <= size / sizeof(indexGroup) &&
+                header.numWords <= size / sizeof(uint64_t) &&
+                header.keysSize <= size && header.wordsSize <= size &&
+                sizeof header + header.numGroups * sizeof(indexGroup) + header.numWords * sizeof(uint64_t) +
+                header.keysSize + header.wordsSize == size;
+    const indexGroup *groups = (const indexGroup *)(base + sizeof header);
+    const uint64_t *wordAt = (const uint64_t *)(groups + (valid ? header.numGroups : 0));
+    const char *keys = (const char *)(wordAt + (valid ? header.numWords : 0));
+    const char *words = keys + (valid ? header.keysSize : 0);
+    // both blobs must end in a terminator so no string runs off the mapping
+    valid = valid && (header.keysSize == 0 || keys[header.keysSize - 1] == '\0') &&
+            (header.wordsSize == 0 || words[header.wordsSize - 1] == '\0');
+    if (!valid)
+    {
+        fprintf(stderr, "ERROR: %s is not a skeleton index\n", path);
+        exit(1);
+    }
+
+    int invalidWords = 0;
+    char input[65];
+    char key[KEY_SIZE];
+    wordReader *reader = newReader(stdin, READ_BLOCK);
+    while (readWord(reader, input))
+    {
+        if (skeleton(input, key) == -1)
+        {
+            fprintf(stderr, "Bad word: %s \n", input);
+            invalidWords++;
+            continue;
+        }
+        size_t lo = 0, hi = header.numGroups;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (groups[mid].keyAt >= header.keysSize)
+            {
+                break;
+            }
+            threadCounts.compares++;
+            if (strcmp(keys + groups[mid].keyAt, key) < 0)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if (lo < header.numGroups && groups[lo].keyAt < header.keysSize &&
+            strcmp(keys + groups[lo].keyAt, key) == 0 &&
+            groups[lo].firstWord <= header.numWords &&
+            groups[lo].numWords <= header.numWords - groups[lo].firstWord)
+        {
+            for (uint64_t w = 0; w < groups[lo].numWords; w++)
+            {
+                uint64_t at = wordAt[groups[lo].firstWord + w];
+                if (at < header.wordsSize)
+                {
+                    printf("%s ", words + at);
+                }
+            }
+        }
+        printf("\n");
+    }
+    free(reader);
+    munmap((void *)base, info.st_size);
+    return invalidWords;
+}
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* one key=value line so benchmark drivers can parse it */
+void printStats(int invalidWords, double seconds)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    flushCounters();
+    counters *c = &totalCounts;
+    fprintf(stderr, "stats: words=%lu invalid=%d groups=%lu probes=%lu compares=%lu "
+                    "compares_per_word=%.2f trie_visits=%lu mallocs=%lu arena_bytes=%lu "
+                    "seconds=%.6f words_per_sec=%.1f peak_rss_kb=%ld\n",
+            c->words, invalidWords, c->groups, c->probes, c->compares,
+            c->words ? (double)c->compares / c->words : 0.0, c->trieVisits, c->mallocs, c->bytes,
+            seconds, seconds > 0 ? c->words / seconds : 0.0, usage.ru_maxrss);
+}
+
+void usage()
+{
+    fprintf(stderr, "Usage: ./noVowal [-j threads] [-b index | -a distance] < words\n"
+                    "       ./noVowal -q index < words\n"
+                    "       ./noVowal -m budgetMB [-T tmpdir] < words\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int numThreads = 1, maxDist = 0;
+    long budgetMB = 0;
+    const char *buildPath = NULL, *queryPath = NULL, *tmpDir = NULL;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            usage();
+        }
+        if (strcmp(argv[i], "-j") == 0)
+        {
+            numThreads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            buildPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-q") == 0)
+        {
+            queryPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-m") == 0)
+        {
+            budgetMB = atol(argv[i + 1]);
+            if (budgetMB < 1)
+            {
+                usage();
+            }
+        }
+        else if (strcmp(argv[i], "-a") == 0)
+        {
+            maxDist = atoi(argv[i + 1]);
+            if (maxDist < 1)
+            {
+                usage();
+            }
+        }
+        else if (strcmp(argv[i], "-T") == 0)
+        {
+            tmpDir = argv[i + 1];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (numThreads < 1 || (queryPath != NULL && (buildPath != NULL || numThreads > 1)) ||
+        (budgetMB > 0 && (queryPath != NULL || buildPath != NULL || numThreads > 1)) ||
+        (tmpDir != NULL && budgetMB == 0) ||
+        (maxDist > 0 && (queryPath != NULL || buildPath != NULL || budgetMB > 0)))
+    {
+        usage();
+    }
+    initKernel();
+    double started = now();
+    int invalidWords;
+    if (queryPath != NULL)
+    {
+        invalidWords = queryIndex(queryPath);
+    }
+    else if (budgetMB > 0)
+    {
+        if (tmpDir == NULL)
+        {
+            tmpDir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+        }
+        invalidWords = groupExternal((size_t)budgetMB << 20, tmpDir);
+    }
+    else
+    {
+        node *groups = numThreads > 1 ? groupParallel(numThreads, &invalidWords)
+                                      : groupSerial(&invalidWords);
+        if (buildPath != NULL)
+        {
+            if (writeIndex(groups, buildPath) == -1)
+            {
+                exit(1);
+            }
+        }
+        else if (groups != NULL)
+        {
+            print(groups);
+            if (maxDist > 0)
+            {
+                printApproximate(groups, maxDist);
+            }
+        }
+    }
+    if (getenv("NOVOWAL_STATS") != NULL)
+    {
+        fflush(stdout);
+        printStats(invalidWords, now() - started);
+    }
+    return invalidWords;
+}
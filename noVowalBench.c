@@ -0,0 +1,254 @@
+/*
+ * corpus generator for benchmarking noVowal.c
+ *
+ * Writes a word stream with a chosen number of distinct skeletons:
+ * skeleton i is i written in base 21 with the consonants as digits, and
+ * every word built on it gets random vowels and random case around those
+ * consonants. The first words cover every skeleton once, after that group
+ * sizes follow a Zipf law (skew 0 is uniform), and a chosen percentage of
+ * tokens is made invalid with a digit or a dash. noVowal measures itself
+ * when NOVOWAL_STATS is set, so a size sweep is a shell loop:
+ *
+ *   for n in 1000 10000 100000 1000000; do
+ *       ./noVowalBench gen -n $n | NOVOWAL_STATS=1 ./noVowal > /dev/null
+ *   done 2>&1 | grep '^stats:'
+ *
+ * check mode runs noVowal on one corpus in memory and again with -m under
+ * a small descriptor limit, so the external sort spills many more runs
+ * than it may keep open, and fails unless both print the same groups:
+ *
+ *   ./noVowalBench check [options] [-b ./noVowal] [-m budgetMB] [-l files]
+ *
+ * options: -n words, -k distinct skeletons, -z Zipf skew of the group
+ *          sizes, -i invalid tokens in percent, -s seed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#define WORDS_PER_LINE 16
+#define MAX_VOWELS 2        // vowels put before each consonant, keeps words under 64 letters
+
+typedef struct {
+    long words;
+    long skeletons;
+    double skew;        // Zipf exponent of the group sizes, 0 for uniform
+    int invalid;        // percent of tokens that are not words
+    unsigned long long seed;
+} Params;
+
+static const char consonants[] = "bcdfghjklmnpqrstvwxyz";
+static const char vowels[] = "aeiou";
+
+static unsigned long long rngState;
+
+/*
+ * xorshift64* -- returns the next 64 random bits
+ */
+static unsigned long long nextRandom()
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+/*
+ * uniform random number in [0, n)
+ */
+static long randomBelow(long n)
+{
+    return (long)(nextRandom() % (unsigned long long)n);
+}
+
+/*
+ * uniform random number in [0, 1)
+ */
+static double randomUnit()
+{
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * cumulative Zipf weights of the skeletons, NULL when the skew is 0
+ */
+static double *zipfTable(const Params *p)
+{
+    if (p->skew == 0)
+        return NULL;
+    double *cdf = malloc(p->skeletons * sizeof(double));
+    if (cdf == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed\n");
+        exit(1);
+    }
+    double sum = 0;
+    for (long i = 0; i < p->skeletons; i++) {
+        sum += pow(i + 1, -p->skew);
+        cdf[i] = sum;
+    }
+    for (long i = 0; i < p->skeletons; i++)
+        cdf[i] /= sum;
+    return cdf;
+}
+
+/*
+ * skeleton of the next word: every skeleton once, then by group size
+ */
+static long pickSkeleton(const Params *p, const double *cdf, long w)
+{
+    if (w < p->skeletons)
+        return w;
+    if (cdf == NULL)
+        return randomBelow(p->skeletons);
+    double u = randomUnit();
+    long lo = 0, hi = p->skeletons - 1;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static char randomCase(char c)
+{
+    return randomBelow(2) ? c - 'a' + 'A' : c;
+}
+
+/*
+ * writes a word on skeleton s into word, spoiled if invalid
+ * returns its length
+ */
+static int makeWord(long s, int invalid, char word[])
+{
+    int len = 0;
+    do {
+        for (long v = randomBelow(MAX_VOWELS + 1); v > 0; v--)
+            word[len++] = randomCase(vowels[randomBelow(5)]);
+        word[len++] = randomCase(consonants[s % 21]);
+        s /= 21;
+    } while (s > 0);
+    if (randomBelow(2))
+        word[len++] = randomCase(vowels[randomBelow(5)]);
+    if (invalid)
+        word[randomBelow(len)] = randomBelow(2) ? '-' : '0' + randomBelow(10);
+    word[len] = '\0';
+    return len;
+}
+
+/*
+ * writes a whole corpus to fp
+ */
+static void generate(FILE *fp, const Params *p)
+{
+    rngState = p->seed ? p->seed : 1;
+    double *cdf = zipfTable(p);
+    char word[64];
+
+    for (long w = 0; w < p->words; w++) {
+        makeWord(pickSkeleton(p, cdf, w), randomBelow(100) < p->invalid, word);
+        fputs(word, fp);
+        fputc((w + 1) % WORDS_PER_LINE == 0 || w + 1 == p->words ? '\n' : ' ', fp);
+    }
+    free(cdf);
+}
+
+/*
+ * compares the output and exit status of noVowal on the corpus in memory
+ * and in -m mode with at most files descriptors
+ * returns 0 if they match, 1 if not
+ */
+static int check(const Params *p, const char *noVowal, long budgetMB, long files)
+{
+    char corpus[] = "/tmp/noVowalBench.XXXXXX";
+    int fd = mkstemp(corpus);
+    FILE *fp = fd == -1 ? NULL : fdopen(fd, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot create corpus file\n");
+        return 1;
+    }
+    generate(fp, p);
+    fclose(fp);
+
+    char inMemory[1024], external[1024];
+    snprintf(inMemory, sizeof inMemory, "%s < %s 2>/dev/null", noVowal, corpus);
+    snprintf(external, sizeof external, "ulimit -n %ld && %s -m %ld < %s 2>/dev/null",
+             files, noVowal, budgetMB, corpus);
+    FILE *a = popen(inMemory, "r");
+    FILE *b = popen(external, "r");
+    long bytes = 0;
+    int same = a != NULL && b != NULL;
+    while (same) {
+        int c = getc(a);
+        same = c == getc(b);
+        if (c == EOF)
+            break;
+        bytes++;
+    }
+    // the exit status of noVowal is its number of bad words
+    int statusA = a != NULL ? pclose(a) : -1;
+    int statusB = b != NULL ? pclose(b) : -1;
+    unlink(corpus);
+    if (!same || statusA != statusB) {
+        fprintf(stderr, "-m %ld with %ld descriptors differs from the in-memory run after %ld bytes\n",
+                budgetMB, files, bytes);
+        return 1;
+    }
+    printf("-m %ld with %ld descriptors: %ld bytes match\n", budgetMB, files, bytes);
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ./noVowalBench gen [-n words] [-k skeletons] [-z skew] "
+            "[-i invalidPercent] [-s seed]\n"
+            "       ./noVowalBench check [options] [-b ./noVowal] [-m budgetMB] [-l files]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    Params p = { 100000, 10000, 1.0, 1, 1 };
+    const char *noVowal = "./noVowal";
+    long budgetMB = 1, files = 20;
+
+    if (argc < 2 || (strcmp(argv[1], "gen") != 0 && strcmp(argv[1], "check") != 0))
+        usage();
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage();
+        const char *opt = argv[i];
+        char *val = argv[++i];
+        if (strcmp(opt, "-n") == 0)
+            p.words = atol(val);
+        else if (strcmp(opt, "-k") == 0)
+            p.skeletons = atol(val);
+        else if (strcmp(opt, "-z") == 0)
+            p.skew = atof(val);
+        else if (strcmp(opt, "-i") == 0)
+            p.invalid = atoi(val);
+        else if (strcmp(opt, "-s") == 0)
+            p.seed = strtoull(val, NULL, 10);
+        else if (strcmp(opt, "-b") == 0)
+            noVowal = val;
+        else if (strcmp(opt, "-m") == 0)
+            budgetMB = atol(val);
+        else if (strcmp(opt, "-l") == 0)
+            files = atol(val);
+        else
+            usage();
+    }
+    if (p.words < 0 || p.skeletons < 1 || p.skew < 0 || p.invalid < 0 || p.invalid > 100 ||
+        budgetMB < 1 || files < 1)
+        usage();
+
+    if (strcmp(argv[1], "check") == 0)
+        return check(&p, noVowal, budgetMB, files);
+    generate(stdout, &p);
+    return 0;
+}